@@ -0,0 +1,48 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+SimdLevel DetectSimdLevel() {
+#if defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse2 = (info[3] & (1 << 26)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	const bool fma = (info[2] & (1 << 12)) != 0;
+
+	// the os has to save the ymm registers on context switches
+	const bool ymmEnabled = osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6);
+
+	bool avx2 = false;
+	if (maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (ymmEnabled && avx2 && fma) {
+		return SimdLevel::AVX2;
+	}
+	if (sse2) {
+		return SimdLevel::SSE2;
+	}
+	return SimdLevel::Scalar;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return SimdLevel::AVX2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return SimdLevel::SSE2;
+	}
+	return SimdLevel::Scalar;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
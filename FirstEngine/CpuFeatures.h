@@ -0,0 +1,11 @@
+#pragma once
+
+// instruction set levels the software pipeline has hand vectorized paths for
+enum class SimdLevel {
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+// highest level supported by both the cpu and the operating system
+SimdLevel DetectSimdLevel();
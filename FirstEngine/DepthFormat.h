@@ -0,0 +1,39 @@
+#pragma once
+
+#include <limits>
+#include <xmmintrin.h>
+
+// how depth values are stored in a z-buffer
+//   Float32 - the interpolated z as is, cleared to infinity
+//   Unorm24 - z in [0, 1] as a 24 bit integer in the low bits of a 32 bit word (the d24x8 layout of gpus)
+//   Unorm16 - z in [0, 1] as a 16 bit integer, half the memory and bandwidth of the others
+// unorm formats are cleared to their largest value, z is clamped to [0, 1] and rounded once per pixel
+enum class DepthFormat {
+	Float32,
+	Unorm24,
+	Unorm16
+};
+
+// bytes of one stored depth
+inline int GetDepthFormatSize(DepthFormat format) {
+	return format == DepthFormat::Unorm16 ? 2 : 4;
+}
+
+// largest stored value of a unorm format, depth 1
+inline unsigned int GetDepthUnormMax(DepthFormat format) {
+	return format == DepthFormat::Unorm16 ? 0xFFFFu : 0xFFFFFFu;
+}
+
+// z to the stored integer of a unorm format, rounded to nearest
+inline unsigned int EncodeDepthUnorm(float z, DepthFormat format) {
+	// a converting instruction rather than + 0.5 and truncation: from 2^23 on float has no halves,
+	// so + 0.5 would round odd integers up and decoded depths would not encode back to themselves
+	const float max = float(GetDepthUnormMax(format));
+	const float clamped = z < 0.0f ? 0.0f : (z < 1.0f ? z : 1.0f);
+	return (unsigned int)_mm_cvtss_si32(_mm_set_ss(clamped * max));
+}
+
+// stored integer of a unorm format back to z
+inline float DecodeDepthUnorm(unsigned int depth, DepthFormat format) {
+	return float(depth) / float(GetDepthUnormMax(format));
+}
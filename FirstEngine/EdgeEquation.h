@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+// edge function E(x, y) = A * x + B * y + C of a directed triangle edge a -> b
+// the triangle interior is on the positive side when vertices are ordered
+// so that E_ab(c) > 0 for the third vertex c
+class EdgeEquation {
+public:
+	using Value = float;
+
+	EdgeEquation() = default;
+	EdgeEquation(float ax, float ay, float bx, float by) {
+		A = by - ay;
+		B = ax - bx;
+		C = -(A * ax + B * ay);
+
+		// top-left fill rule (y grows downwards on screen):
+		// left edges have the interior to their right (A > 0),
+		// top edges are horizontal with the interior below them (A == 0, B > 0)
+		topLeft = (A > 0.0f) || (A == 0.0f && B > 0.0f);
+	}
+
+	float Evaluate(float x, float y) const {
+		return A * x + B * y + C;
+	}
+
+	// value at the center of pixel (x, y), A and B are the steps to the next pixel
+	float EvaluatePixel(int x, int y) const {
+		return Evaluate(float(x) + 0.5f, float(y) + 0.5f);
+	}
+
+	// change in value from a pixel center to a sample (dx, dy) / 16 pixels away
+	float SampleOffset(int dx, int dy) const {
+		return (A * float(dx) + B * float(dy)) * (1.0f / 16.0f);
+	}
+
+	// samples exactly on the edge belong to the triangle only for top and left edges
+	bool Test(float e) const {
+		return e > 0.0f || (e == 0.0f && topLeft);
+	}
+
+	// offsets from the first sample of a square block (size samples per side)
+	// to the block corner with the smallest / largest edge value
+	float MinBlockOffset(int size) const {
+		const float extent = float(size - 1);
+		return std::min(A, 0.0f) * extent + std::min(B, 0.0f) * extent;
+	}
+
+	float MaxBlockOffset(int size) const {
+		const float extent = float(size - 1);
+		return std::max(A, 0.0f) * extent + std::max(B, 0.0f) * extent;
+	}
+
+public:
+	float A;
+	float B;
+	float C;
+	bool topLeft;
+};
+
+// the same edge function with vertices snapped to 28.4 fixed point (1/16 pixel)
+// evaluated and stepped in integers, so coverage is exact: pixels on an edge shared by two
+// triangles go to exactly one of them, and results do not depend on compiler or fpu settings
+//
+// E is kept in 1/256 pixel units, A and B are the integer steps from one pixel center to the next
+// the top-left rule is folded into C (non top-left edges are biased by -1), so a sample is
+// inside when E >= 0
+class FixedEdgeEquation {
+public:
+	using Value = long long;
+
+	static constexpr int SubpixelBits = 4;
+	static constexpr int SubpixelScale = 1 << SubpixelBits;
+
+	// screen coordinates beyond this many pixels from the origin can not be snapped
+	static constexpr float MaxCoordinate = float(1 << 26);
+
+	static int Snap(float v) {
+		return (int)std::floor(v * float(SubpixelScale) + 0.5f);
+	}
+
+	// first pixel whose center is at or right of (below) the snapped coordinate v
+	static int FirstPixel(int v) {
+		return -((SubpixelScale / 2 - v) >> SubpixelBits);
+	}
+
+	// last pixel whose center is at or left of (above) the snapped coordinate v
+	static int LastPixel(int v) {
+		return (v - SubpixelScale / 2) >> SubpixelBits;
+	}
+
+	FixedEdgeEquation() = default;
+	FixedEdgeEquation(int ax, int ay, int bx, int by) {
+		const Value a = Value(by) - ay;
+		const Value b = Value(ax) - bx;
+
+		// same orientation and fill rule as EdgeEquation
+		topLeft = (a > 0) || (a == 0 && b > 0);
+
+		// E at the center of pixel (x, y), which lies at (16 * x + 8, 16 * y + 8)
+		A = a * SubpixelScale;
+		B = b * SubpixelScale;
+		C = a * (SubpixelScale / 2 - ax) + b * (SubpixelScale / 2 - ay) - (topLeft ? 0 : 1);
+	}
+
+	Value EvaluatePixel(int x, int y) const {
+		return A * x + B * y + C;
+	}
+
+	// change in E from a pixel center to a sample (dx, dy) subpixels away, exact
+	Value SampleOffset(int dx, int dy) const {
+		return (A / SubpixelScale) * dx + (B / SubpixelScale) * dy;
+	}
+
+	bool Test(Value e) const {
+		return e >= 0;
+	}
+
+	Value MinBlockOffset(int size) const {
+		const Value extent = size - 1;
+		return std::min<Value>(A, 0) * extent + std::min<Value>(B, 0) * extent;
+	}
+
+	Value MaxBlockOffset(int size) const {
+		const Value extent = size - 1;
+		return std::max<Value>(A, 0) * extent + std::max<Value>(B, 0) * extent;
+	}
+
+public:
+	Value A;
+	Value B;
+	Value C;
+	bool topLeft;
+};
@@ -16,6 +16,11 @@ EngineOptions::EngineOptions() {
 	m_screenNear			= 0.1f;
 	m_fov					= DirectX::XM_PIDIV2;
 	m_aspectRatio = 1.0f;
+	m_rasterThreads			= 1;
+	m_fastShading			= true;
+	m_depthBits				= 32;
+	m_depthPrepass			= false;
+	m_msaaSamples			= 1;
 }
 
 EngineOptions::~EngineOptions() {}
@@ -73,6 +78,28 @@ void EngineOptions::Init(const char* xmlFileName, LPWSTR lpCmdLine) {
 			if (pNode->Attribute("screenNear")) {
 				m_screenNear = atof(pNode->Attribute("screenNear"));
 			}
+
+			if (pNode->Attribute("rasterThreads")) {
+				m_rasterThreads = atoi(pNode->Attribute("rasterThreads"));
+			}
+
+			if (pNode->Attribute("fastShading")) {
+				attribute = pNode->Attribute("fastShading");
+				m_fastShading = (attribute == "yes") ? true : false;
+			}
+
+			if (pNode->Attribute("depthBits")) {
+				m_depthBits = atoi(pNode->Attribute("depthBits"));
+			}
+
+			if (pNode->Attribute("depthPrepass")) {
+				attribute = pNode->Attribute("depthPrepass");
+				m_depthPrepass = (attribute == "yes") ? true : false;
+			}
+
+			if (pNode->Attribute("msaaSamples")) {
+				m_msaaSamples = atoi(pNode->Attribute("msaaSamples"));
+			}
 		}
 
 		pNode = pRoot->FirstChildElement("Sound");
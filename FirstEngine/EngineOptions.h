@@ -17,6 +17,11 @@ struct EngineOptions {
 	float		m_screenNear;
 	float		m_fov;
 	float		m_aspectRatio;
+	int			m_rasterThreads; // software rasterizer threads, 0 - hardware concurrency
+	bool		m_fastShading; // approximate software shading math (colors usually within 1/255 of the exact path)
+	int			m_depthBits; // software z-buffer precision, 32 - float, 24 or 16 - fixed point
+	bool		m_depthPrepass; // software rasterizer lays down depth first and shades visible pixels only
+	int			m_msaaSamples; // software rasterizer samples per pixel, 1 or 4
 
 	// Sound options
 	float m_soundEffectsVolume;
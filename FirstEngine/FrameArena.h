@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// bump allocator for memory that only lives until the end of a frame
+// allocations are never freed one by one, Reset releases all of them at once
+// a frame that needs more than the block holds spills into extra heap blocks, the next Reset
+// replaces everything with a single block big enough for the high water mark,
+// so once the high water mark is reached frames run without touching the heap
+class FrameArena {
+public:
+	static constexpr size_t DefaultCapacity = 1u << 20;
+
+	explicit FrameArena(size_t capacity = DefaultCapacity) {
+		AllocateBlock(capacity);
+	}
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment) {
+		size_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+		if (offset + size > mBlockSize) {
+			// spill into a new block, at least as big as everything allocated so far
+			AllocateBlock(std::max(size + alignment, mUsed + mBlockSize));
+			offset = (mOffset + alignment - 1) & ~(alignment - 1);
+		}
+
+		mUsed += offset + size - mOffset;
+		mOffset = offset + size;
+		mHighWaterMark = std::max(mHighWaterMark, mUsed);
+		return mBlock + offset;
+	}
+
+	// uninitialized storage for count objects, only meant for trivial types
+	template<typename T>
+	T* Allocate(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "frame arena memory is never destroyed");
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// releases every allocation of the frame
+	void Reset() {
+		if (mBlocks.size() > 1) {
+			// the last frame did not fit, make room for all of it in one block
+			mBlocks.clear();
+			AllocateBlock(mHighWaterMark + mHighWaterMark / 4);
+		}
+		mOffset = 0;
+		mUsed = 0;
+	}
+
+	// bytes allocated since the last Reset (alignment padding included)
+	size_t GetUsed() const {
+		return mUsed;
+	}
+
+	// most bytes any frame has allocated
+	size_t GetHighWaterMark() const {
+		return mHighWaterMark;
+	}
+
+	// bytes held from the heap
+	size_t GetCapacity() const {
+		size_t capacity = 0;
+		for (auto& block : mBlocks) {
+			capacity += block.size;
+		}
+		return capacity;
+	}
+
+	// heap blocks allocated over the lifetime of the arena, stops growing once the high water mark settles
+	size_t GetBlockAllocations() const {
+		return mBlockAllocations;
+	}
+
+private:
+	struct Block {
+		std::unique_ptr<char[]>	memory;
+		size_t					size;
+	};
+
+	void AllocateBlock(size_t size) {
+		mBlocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+		mBlock = mBlocks.back().memory.get();
+		mBlockSize = size;
+		mOffset = 0;
+		mBlockAllocations++;
+	}
+
+	std::vector<Block>	mBlocks;
+	char*				mBlock = nullptr;
+	size_t				mBlockSize = 0;
+	size_t				mOffset = 0;
+	size_t				mUsed = 0;
+	size_t				mHighWaterMark = 0;
+	size_t				mBlockAllocations = 0;
+};
+
+// growable array living in a FrameArena
+// growing copies into a new allocation twice the size and leaves the old one behind,
+// which costs at most as much again as the final array
+// must be cleared whenever the arena is reset
+template<typename T>
+class FrameArray {
+	static_assert(std::is_trivially_copyable<T>::value, "frame arrays are grown with memcpy");
+
+public:
+	static constexpr size_t MinCapacity = 16;
+
+	void PushBack(FrameArena& arena, const T& value) {
+		if (mSize == mCapacity) {
+			Grow(arena, std::max(mCapacity * 2, MinCapacity));
+		}
+		mData[mSize++] = value;
+	}
+
+	// forgets the contents, the storage goes back with the next arena Reset
+	void Clear() {
+		mData = nullptr;
+		mSize = 0;
+		mCapacity = 0;
+	}
+
+	T& operator[](size_t i) {
+		return mData[i];
+	}
+
+	const T& operator[](size_t i) const {
+		return mData[i];
+	}
+
+	T& Back() {
+		return mData[mSize - 1];
+	}
+
+	size_t Size() const {
+		return mSize;
+	}
+
+	bool Empty() const {
+		return mSize == 0;
+	}
+
+	T* begin() {
+		return mData;
+	}
+
+	T* end() {
+		return mData + mSize;
+	}
+
+	const T* begin() const {
+		return mData;
+	}
+
+	const T* end() const {
+		return mData + mSize;
+	}
+
+private:
+	void Grow(FrameArena& arena, size_t capacity) {
+		T* data = arena.Allocate<T>(capacity);
+		if (mSize > 0) {
+			std::memcpy(data, mData, mSize * sizeof(T));
+		}
+		mData = data;
+		mCapacity = capacity;
+	}
+
+	T*		mData = nullptr;
+	size_t	mSize = 0;
+	size_t	mCapacity = 0;
+};
+
+template<typename T>
+constexpr size_t FrameArray<T>::MinCapacity;
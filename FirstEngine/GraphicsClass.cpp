@@ -86,10 +86,14 @@ bool GraphicsClass::Initialize(const EngineOptions& options, HWND hwnd) {
 	}
 
 	// Create scene object.
-	m_Scene = std::shared_ptr<SpecularPhongPointScene>(new SpecularPhongPointScene(m_TextureHolder->GetTexture("soft"), m_TextureHolder->GetTexture("stone01.tga")));
+	const DepthFormat depthFormat = options.m_depthBits == 16 ? DepthFormat::Unorm16 : options.m_depthBits == 24 ? DepthFormat::Unorm24 : DepthFormat::Float32;
+	m_Scene = std::shared_ptr<SpecularPhongPointScene>(new SpecularPhongPointScene(m_TextureHolder->GetTexture("soft"), m_TextureHolder->GetTexture("stone01.tga"), options.m_rasterThreads, options.m_fastShading, depthFormat));
 	if (!m_Scene) {
 		return false;
 	}
+	m_Scene->SetClearColor(IntColors::MakeRGB(255u, 0u, 0u));
+	m_Scene->SetDepthPrepass(options.m_depthPrepass);
+	m_Scene->SetSampleCount(options.m_msaaSamples);
 
 	return true;
 }
@@ -126,8 +130,7 @@ void GraphicsClass::Update(const GameTimer& gt) {
 bool GraphicsClass::Frame() {
 	bool result;
 
-	TextureClass& softTexture = m_TextureHolder->GetTexture("soft");
-	softTexture.Clear(IntColors::MakeRGB(255u, 0u, 0u));
+	// the scene's pipeline clears the soft texture
 	//softTexture.DrawLine(0, 0, 512, 512, { 255, 0, 0, 0 });
 
 	m_Scene->Draw();
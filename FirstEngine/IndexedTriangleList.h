@@ -9,6 +9,7 @@
 #include <cctype>
 
 #include "Vertex.h"
+#include "VertexStreams.h"
 #include "tiny_obj_loader.h"
 
 class IndexedTriangleList {
@@ -93,6 +94,7 @@ public:
 			}
 		}
 
+		tl.BuildStreams();
 		return tl;
 	}
 
@@ -184,9 +186,38 @@ public:
 			}
 		}
 
+		tl.BuildStreams();
 		return tl;
 	}
 
+	// (re)builds the structure of arrays copy of the vertices, the pipeline shades meshes that have one
+	// with the batched vertex shader
+	void BuildStreams() {
+		streams.Assign(vertices);
+		hasStreams = true;
+		streamsVersion = vertexVersion;
+	}
+
+	// call after writing to the vertices, the streams of the mesh are rebuilt on its next draw
+	void VerticesChanged() {
+		vertexVersion++;
+	}
+
+	bool HasStreams() const {
+		return hasStreams;
+	}
+
+	// a resized vertex list counts as changed even without VerticesChanged
+	bool HasStaleStreams() const {
+		return hasStreams && (streamsVersion != vertexVersion || streams.Size() != vertices.size());
+	}
+
 	std::vector<Vertex> vertices;
 	std::vector<size_t> indices;
+	VertexStreams streams;
+
+private:
+	bool			hasStreams = false;
+	unsigned int	vertexVersion = 0u;
+	unsigned int	streamsVersion = 0u;
 };
\ No newline at end of file
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// attributes an interpolant can carry next to its position
+// effects combine them into the mask their VSOutput is declared with
+struct InterpolantAttribute {
+	static constexpr unsigned int Normal	= 1u << 0;
+	static constexpr unsigned int WorldPos	= 1u << 1;
+	static constexpr unsigned int TexCoord	= 1u << 2;
+};
+
+// === interpolant layers ===
+//   every attribute is one layer stacked on the position, a disabled layer
+//   adds no members and no arithmetic (empty single base, so it takes no space either)
+//   Combine applies op(lhs, rhs) to every float, Transform applies op(value)
+
+class InterpolantPosition {
+public:
+	template<typename Op>
+	void Combine(const InterpolantPosition& rhs, Op op) {
+		op(pos.x, rhs.pos.x);
+		op(pos.y, rhs.pos.y);
+		op(pos.z, rhs.pos.z);
+		op(pos.w, rhs.pos.w);
+	}
+
+	template<typename Op>
+	void Transform(Op op) {
+		op(pos.x);
+		op(pos.y);
+		op(pos.z);
+		op(pos.w);
+	}
+
+	// attributes other than the position are copied from src
+	void CopyAttributes(const InterpolantPosition& src) {}
+
+public:
+	DirectX::XMFLOAT4 pos;
+};
+
+template<bool Enabled, typename Base>
+class InterpolantNormal : public Base {};
+
+template<typename Base>
+class InterpolantNormal<true, Base> : public Base {
+public:
+	template<typename Op>
+	void Combine(const InterpolantNormal& rhs, Op op) {
+		Base::Combine(rhs, op);
+		op(n.x, rhs.n.x);
+		op(n.y, rhs.n.y);
+		op(n.z, rhs.n.z);
+	}
+
+	template<typename Op>
+	void Transform(Op op) {
+		Base::Transform(op);
+		op(n.x);
+		op(n.y);
+		op(n.z);
+	}
+
+	void CopyAttributes(const InterpolantNormal& src) {
+		Base::CopyAttributes(src);
+		n = src.n;
+	}
+
+public:
+	DirectX::XMFLOAT3 n;
+};
+
+template<bool Enabled, typename Base>
+class InterpolantWorldPos : public Base {};
+
+template<typename Base>
+class InterpolantWorldPos<true, Base> : public Base {
+public:
+	template<typename Op>
+	void Combine(const InterpolantWorldPos& rhs, Op op) {
+		Base::Combine(rhs, op);
+		op(worldPos.x, rhs.worldPos.x);
+		op(worldPos.y, rhs.worldPos.y);
+		op(worldPos.z, rhs.worldPos.z);
+	}
+
+	template<typename Op>
+	void Transform(Op op) {
+		Base::Transform(op);
+		op(worldPos.x);
+		op(worldPos.y);
+		op(worldPos.z);
+	}
+
+	void CopyAttributes(const InterpolantWorldPos& src) {
+		Base::CopyAttributes(src);
+		worldPos = src.worldPos;
+	}
+
+public:
+	DirectX::XMFLOAT3 worldPos;
+};
+
+template<bool Enabled, typename Base>
+class InterpolantTexCoord : public Base {};
+
+template<typename Base>
+class InterpolantTexCoord<true, Base> : public Base {
+public:
+	template<typename Op>
+	void Combine(const InterpolantTexCoord& rhs, Op op) {
+		Base::Combine(rhs, op);
+		op(t.x, rhs.t.x);
+		op(t.y, rhs.t.y);
+	}
+
+	template<typename Op>
+	void Transform(Op op) {
+		Base::Transform(op);
+		op(t.x);
+		op(t.y);
+	}
+
+	void CopyAttributes(const InterpolantTexCoord& src) {
+		Base::CopyAttributes(src);
+		t = src.t;
+	}
+
+public:
+	DirectX::XMFLOAT2 t;
+};
+
+// vertex shader output interpolated across triangles in screen space
+// Attributes is a mask of InterpolantAttribute bits, the members (pos always, n, worldPos, t)
+// and the arithmetic on them are generated for exactly those attributes,
+// so a depth-only pass interpolates 4 floats and a textured one 6 instead of 12
+template<unsigned int Attributes>
+class Interpolant :
+	public InterpolantTexCoord<(Attributes & InterpolantAttribute::TexCoord) != 0u,
+		InterpolantWorldPos<(Attributes & InterpolantAttribute::WorldPos) != 0u,
+		InterpolantNormal<(Attributes & InterpolantAttribute::Normal) != 0u,
+		InterpolantPosition>>> {
+public:
+	Interpolant() = default;
+	Interpolant(const DirectX::XMFLOAT4& pos) {
+		this->pos = pos;
+	}
+	Interpolant(const DirectX::XMFLOAT4& pos, const Interpolant& src) {
+		this->CopyAttributes(src);
+		this->pos = pos;
+	}
+
+	static constexpr bool Has(unsigned int attribute) {
+		return (Attributes & attribute) == attribute;
+	}
+
+	Interpolant& operator+=(const Interpolant& rhs) {
+		this->Combine(rhs, [](float& lhs, float rhs) { lhs += rhs; });
+		return *this;
+	}
+
+	Interpolant operator+(const Interpolant& rhs) const {
+		return Interpolant(*this) += rhs;
+	}
+
+	Interpolant& operator-=(const Interpolant& rhs) {
+		this->Combine(rhs, [](float& lhs, float rhs) { lhs -= rhs; });
+		return *this;
+	}
+
+	Interpolant operator-(const Interpolant& rhs) const {
+		return Interpolant(*this) -= rhs;
+	}
+
+	Interpolant& operator*=(float rhs) {
+		this->Transform([rhs](float& value) { value *= rhs; });
+		return *this;
+	}
+
+	Interpolant operator*(float rhs) const {
+		return Interpolant(*this) *= rhs;
+	}
+
+	Interpolant& operator/=(float rhs) {
+		this->Transform([rhs](float& value) { value /= rhs; });
+		return *this;
+	}
+
+	Interpolant operator/(float rhs) const {
+		return Interpolant(*this) /= rhs;
+	}
+};
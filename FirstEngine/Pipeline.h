@@ -0,0 +1,2035 @@
+#pragma once
+
+#include <cmath>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#include "ZBuffer.h"
+#include "Triangle.h"
+#include "EdgeEquation.h"
+#include "TextureClass.h"
+#include "IndexedTriangleList.h"
+#include "NDCScreenTransformer.h"
+#include "EngineOptions.h"
+#include "ThreadPool.h"
+#include "SpanKernels.h"
+#include "FrameArena.h"
+#include "Interpolant.h"
+
+// software rasterization pipeline, shaders are supplied by the Effect and called directly
+// (no virtual dispatch, everything inlines into the raster loops)
+//
+// Effect must provide
+//   VSOutput       - interpolant with a DirectX::XMFLOAT4 pos and +, -, * float, / float (see Interpolant)
+//   VertexShader   - vs, VSOutput operator()(Vertex&) and DirectX::XMFLOAT4X4& GetProj() (for backface culling),
+//                    called from several threads at once for big meshes, so it must not modify itself
+//                    plus void operator()(const VertexStreams&, size_t begin, size_t end, VSOutput* out, SimdLevel) const,
+//                    shading vertices [begin, end) of meshes with vertex streams into out[begin, end)
+//   GeometryShader - gs, Triangle<const VSOutput&> operator()(const VSOutput&, const VSOutput&, const VSOutput&, size_t triangle_index)
+//                    vertices passed through by reference reuse their cached clip codes and screen space copies,
+//                    vertices the gs makes itself must stay alive until it is called again
+//   PixelShader    - ps, ColorIntegers operator()(VSOutput&, const VSOutput& ddx, const VSOutput& ddy) for single pixels and
+//                    void operator()(const VSOutput (&)[4], unsigned int laneMask, const VSOutput& ddx, const VSOutput& ddy,
+//                    unsigned int (&colors)[4]) for 2x2 quads (packed ColorIntegers, only lanes in laneMask are used),
+//                    trivially copyable (binned and visibility buffer draws keep a copy in the frame arena until EndFrame)
+template<class Effect>
+class Pipeline {
+public:
+	using VSOutput		= typename Effect::VSOutput;
+	using PixelShader	= typename Effect::PixelShader;
+
+	// triangle referring to vertices stored elsewhere (vertex cache, clipper, frame triangles)
+	using TriangleRef	= Triangle<const VSOutput&>;
+
+	// position only interpolant of the depth prepass
+	using DepthVertex	= Interpolant<0u>;
+
+	// triangle rasterization strategy
+	//   Scanline  - splits triangles into flat top / flat bottom halves and walks edges per scanline
+	//   HalfSpace - evaluates edge functions over BlockSize x BlockSize pixel blocks,
+	//               accepts fully covered blocks whole and tests only partially covered ones per pixel,
+	//               shades in 2x2 quads so the pixel shader gets attribute derivatives
+	//   FixedPoint - HalfSpace with vertices snapped to 28.4 fixed point and integer edge functions,
+	//                watertight and bit-reproducible coverage
+	enum class RasterMode {
+		Scanline,
+		HalfSpace,
+		FixedPoint
+	};
+
+	// what happens to pixels that pass the depth test
+	//   Forward          - the pixel shader runs right away, later triangles may overwrite the result
+	//   VisibilityBuffer - only the triangle id is stored, EndFrame reconstructs the attributes
+	//                      and runs the pixel shader exactly once per visible pixel (in 2x2 quads)
+	//   DepthPrepass     - triangles are kept until EndFrame, which rasterizes them twice (per tile when binning):
+	//                      depth only with positions as the sole interpolant, then again with an equal depth test
+	//                      that shades only the pixels left in front, so hidden pixels never reach the pixel shader
+	//                      (coplanar overlaps are shaded by every triangle at the front depth, the last one wins)
+	enum class ShadingMode {
+		Forward,
+		VisibilityBuffer,
+		DepthPrepass
+	};
+
+	// where color and depth live while the frame is drawn
+	//   Linear - straight in the render target and a row linear z-buffer
+	//   Tiled  - in TileSize x TileSize tiles (16 KiB of color and 16 KiB of depth each) that stay in cache
+	//            while a bin is rasterized, BeginFrame loads the render target into the tiles (or clears them)
+	//            and EndFrame resolves them back, the render target is only valid after EndFrame
+	enum class TargetLayout {
+		Linear,
+		Tiled
+	};
+
+	static constexpr int BlockSize = 8;
+	static_assert(BlockSize == ZBuffer::TileSize, "raster blocks are rejected against single coarse depth tiles");
+
+	// screen tile size for sort-middle binning, multiple of BlockSize so that tiles
+	// split triangles exactly at block borders and binned output matches direct output
+	static constexpr int TileSize = 64;
+	static_assert(TileSize == ZBuffer::StorageTileSize, "bins own whole color and depth tiles");
+
+	// samples per pixel of multisampling
+	static constexpr int MaxSamples = ZBuffer::MaxSamples;
+
+	Pipeline(TextureClass& sysT);
+
+	void SetRasterMode(RasterMode mode);
+	RasterMode GetRasterMode() const;
+
+	void SetShadingMode(ShadingMode mode);
+	ShadingMode GetShadingMode() const;
+
+	// number of threads rasterizing the frame, 0 picks the hardware concurrency
+	// with more than one thread HalfSpace and FixedPoint triangles are binned into screen tiles during Draw
+	// and the tiles are rasterized in parallel by EndFrame
+	void SetThreadCount(unsigned int threadCount);
+	unsigned int GetThreadCount() const;
+
+	// instruction set used by the span kernels, picked from the cpu at construction
+	// requests above what the cpu supports are clamped
+	void SetSimdLevel(SimdLevel level);
+	SimdLevel GetSimdLevel() const;
+
+	void SetTargetLayout(TargetLayout layout);
+	TargetLayout GetTargetLayout() const;
+
+	// storage of the z-buffer, depths already drawn are converted
+	void SetDepthFormat(DepthFormat format);
+	DepthFormat GetDepthFormat() const;
+
+	// 1 or MaxSamples (other counts are rounded down to one of them)
+	// with MaxSamples every pixel keeps a depth and a color per sample, the pixel shader still runs once
+	// per pixel and triangle and its color goes to the covered samples that passed the depth test,
+	// EndFrame averages the samples into the render target
+	// only HalfSpace and FixedPoint rasterize samples, Scanline and VisibilityBuffer draw single sampled
+	void SetSampleCount(unsigned int count);
+	unsigned int GetSampleCount() const;
+
+	// transient vertex, clip and bin storage of the current frame, reset in BeginFrame
+	// its high water mark is the memory a frame needs to run without heap allocations
+	const FrameArena& GetFrameArena() const;
+
+	void Draw(IndexedTriangleList& triList);
+
+	// needed to reset the z-buffer after each frame
+	// the frame is drawn over what the render target holds
+	void BeginFrame();
+
+	// same, on a render target cleared to clearColor
+	// a Tiled target is cleared lazily: tiles are only flagged, a tile is filled with the color
+	// when the first pixel is drawn into it and tiles nothing was drawn into go straight to the resolve
+	void BeginFrame(ColorIntegers clearColor);
+
+	// rasterizes binned triangles, shades the visibility buffer and resolves color tiles,
+	// must be called before the render target is read
+	void EndFrame();
+
+private:
+	// pixel area [xStart, xEnd) x [yStart, yEnd) a triangle is rasterized into
+	struct ScreenRect {
+		int xStart;
+		int yStart;
+		int xEnd;
+		int yEnd;
+	};
+
+	// post-transform triangle kept for the rest of the frame along with the draw it came from
+	// (waiting in the bins, or referenced by id from the visibility buffer)
+	struct FrameTriangle {
+		Triangle<VSOutput>	triangle;
+		size_t				drawIndex;
+
+		// attribute plane equations, only set up in VisibilityBuffer mode
+		VSOutput			ditdx;
+		VSOutput			ditdy;
+	};
+
+	// interpolants of a screen space triangle as plane equations
+	//   it(x, y) = it0 + ditdx * (x - it0.pos.x) + ditdy * (y - it0.pos.y)
+	struct AttributePlanes {
+		VSOutput	it0;
+		VSOutput	ditdx;
+		VSOutput	ditdy;
+	};
+
+	// rasterization pass of a triangle
+	//   Color     - depth test and write, then shade (or store the id in the visibility buffer)
+	//   DepthOnly - depth test and write, nothing else (first pass of the depth prepass)
+	//   Shade     - equal depth test without writes, then shade (second pass of the depth prepass)
+	enum class RasterPass {
+		Color,
+		DepthOnly,
+		Shade
+	};
+
+	// where the rasterizer sends pixels that pass the depth test
+	// forward shading invokes ps, visibility buffer shading (ps == nullptr) stores triangleId
+	struct RasterContext {
+		PixelShader*	ps;
+		unsigned int	triangleId;
+		RasterPass		pass;
+	};
+
+	// the shade pass pulls its coarse depth bounds in by this fraction of the depth (see GetCullDepth)
+	static constexpr float CullMargin = 1.0f / 65536.0f;
+
+	// rotated grid positions of the samples in 1/16 pixel from the pixel center (the d3d standard pattern),
+	// a single sample sits at the center
+	static constexpr int SampleOffsetX[MaxSamples] = { -2, 6, -6, 2 };
+	static constexpr int SampleOffsetY[MaxSamples] = { -6, -2, 2, 6 };
+
+	// farthest a sample lies from its pixel center along x or y, in 1/16 pixel
+	static constexpr int SampleReach = 6;
+
+	static constexpr unsigned int NoTriangle = ~0u;
+
+	// index of a vertex that is not in the vertex cache (made by the gs or the clipper)
+	static constexpr size_t NoVertex = ~size_t(0);
+
+	// clip space planes, one bit each in a vertex outcode
+	static constexpr unsigned int ClipLeft		= 1u << 0;
+	static constexpr unsigned int ClipRight		= 1u << 1;
+	static constexpr unsigned int ClipBottom	= 1u << 2;
+	static constexpr unsigned int ClipTop		= 1u << 3;
+	static constexpr unsigned int ClipNear		= 1u << 4;
+	static constexpr unsigned int ClipFar		= 1u << 5;
+
+	// clip codes of a vertex: view volume outcode in the low bits, guard band outcode shifted up by this
+	static constexpr int GuardBandCodeShift = 8;
+
+	// x and y are only clipped against -GuardBand * w <= x, y <= GuardBand * w,
+	// triangles reaching less far off the screen are trimmed by the rasterizer's bounding box instead
+	static constexpr float GuardBand = 4.0f;
+
+	// convex polygon left of a triangle by clipping, every plane adds at most one vertex
+	struct ClipPolygon {
+		static constexpr int MaxVertices = 3 + 6;
+
+		VSOutput	vertices[MaxVertices];
+		int			count;
+	};
+
+	// meshes with fewer vertices are shaded inline, bigger ones in chunks of VertexChunkSize on the thread pool
+	static constexpr size_t ParallelVertexThreshold = 4096;
+	static constexpr size_t VertexChunkSize = 1024;
+
+	// vertex shading of the current draw, split into chunks for the thread pool
+	struct VertexJobs {
+		std::vector<Vertex>*	vertices;
+		const VertexStreams*	streams;
+		std::vector<size_t>*	indices;
+		size_t					chunkCount;
+		std::atomic<size_t>		nextChunk;
+		// set once a chunk is in the vertex cache, from the frame arena
+		std::atomic<bool>*		chunkDone;
+	};
+
+	// vertex processing function
+	// transforms vertices using vs into the vertex cache, along with their clip codes
+	// and screen space copies, and then passes the idx list to triangle assembler
+	// with a thread pool, big meshes are assembled while their vertices are still being shaded
+	// streams is the structure of arrays copy of the vertices if the mesh has one (nullptr otherwise),
+	// those are shaded with the batched vs
+	void ProcessVertices(std::vector<Vertex>& vertices, const VertexStreams* streams, std::vector<size_t>& indices);
+
+	// shades vertices [begin, end) into the vertex cache
+	void ShadeVertices(std::vector<Vertex>& vertices, const VertexStreams* streams, size_t begin, size_t end);
+
+	// shades the next unclaimed chunk of mVertexJobs, false once all chunks are claimed
+	bool RunVertexChunk();
+
+	// blocks until the vertex is in the vertex cache, shading other chunks in the meantime
+	void WaitForVertex(size_t index);
+
+	// triangle assembly function
+	// assembles indexed vertex stream from the vertex cache into triangles and passes them on by index
+	// culls (does not send) back facing triangles
+	void AssembleTriangles(std::vector<size_t>& indices);
+
+	// triangle processing function
+	// passes 3 cached vertices to gs to generate triangle
+	// sends generated triangle to the clipper
+	void ProcessTriangle(size_t i0, size_t i1, size_t i2, size_t triangle_index);
+
+	// culls triangles outside the view volume, clips the rest against the near and far planes
+	// and the guard band and sends the pieces to the rasterizer
+	// indices are the vertex cache entries of the vertices (or NoVertex)
+	void ClipCullTriangle(const TriangleRef& t, const size_t (&indices)[3]);
+
+	// bits of the planes the position is outside of, x and y planes scaled by band
+	static unsigned int ComputeOutcode(const DirectX::XMFLOAT4& pos, float band);
+
+	// view volume and guard band outcodes (see GuardBandCodeShift)
+	static unsigned int ComputeClipCodes(const DirectX::XMFLOAT4& pos);
+
+	// signed distance to a clip plane (guard band for x and y), negative outside
+	static float ClipDistance(const DirectX::XMFLOAT4& pos, unsigned int plane);
+
+	// Sutherland-Hodgman step, out gets the part of in on the inner side of plane
+	static void ClipPolygonAgainstPlane(const ClipPolygon& in, ClipPolygon& out, unsigned int plane);
+
+	// vertex post-processing function
+	// perspective and viewport transformation of a vertex, from the vertex cache when it is in there
+	// (otherwise transformed into scratch)
+	const VSOutput& GetScreenVertex(const VSOutput& v, size_t index, VSOutput& scratch) const;
+
+	// sends a screen space triangle to the rasterizer of the current mode (or to the bins)
+	void DrawScreenTriangle(const TriangleRef& triangle);
+
+	// === triangle rasterization functions ===
+	//   it0, it1, etc. stand for interpolants
+	//   (values which are interpolated across a triangle in screen space)
+	//
+	// entry point for tri rasterization
+	// sets up the attribute plane equations, sorts vertices, determines case,
+	// splits to flat tris, dispatches to flat tri funcs
+	void DrawTriangle(const TriangleRef& triangle, const RasterContext& context);
+
+	// does flat *TOP* tri-specific calculations and calls DrawFlatTriangle
+	void DrawFlatTopTriangle(const DirectX::XMFLOAT4& p0, const DirectX::XMFLOAT4& p1, const DirectX::XMFLOAT4& p2, const AttributePlanes& planes, const RasterContext& context);
+
+	// does flat *BOTTOM* tri-specific calculations and calls DrawFlatTriangle
+	void DrawFlatBottomTriangle(const DirectX::XMFLOAT4& p0, const DirectX::XMFLOAT4& p1, const DirectX::XMFLOAT4& p2, const AttributePlanes& planes, const RasterContext& context);
+
+	// does processing common to both flat top and flat bottom tris
+	// walks the x of both edges over the scanlines, evaluates the interpolants from the plane equations,
+	// depth cull, invoke ps and write pixel to screen
+	void DrawFlatTriangle(const DirectX::XMFLOAT4& p0, const DirectX::XMFLOAT4& p2, float dxdy0, float dxdy1, float xEdge1, const AttributePlanes& planes, const RasterContext& context);
+
+	// entry point for half-space tri rasterization
+	// sets up edge equations and attribute gradients, walks the bounding box in blocks,
+	// rejects blocks outside of any edge, shades covered blocks without per pixel edge tests
+	// only pixels inside rect are touched
+	// V is VSOutput, or DepthVertex for the depth only pass
+	template<typename V>
+	void DrawTriangleHalfSpace(const Triangle<const V&>& triangle, const RasterContext& context, const ScreenRect& rect);
+
+	// half-space rasterization with FixedEdgeEquation edges
+	// triangles reaching beyond FixedEdgeEquation::MaxCoordinate go to DrawTriangleHalfSpace
+	template<typename V>
+	void DrawTriangleFixedPoint(const Triangle<const V&>& triangle, const RasterContext& context, const ScreenRect& rect);
+
+	// block walk shared by the half-space rasterizers, Edge is EdgeEquation or FixedEdgeEquation
+	// bounds holds the pixels whose centers may be covered, already clamped to the target rect
+	template<typename Edge, typename V>
+	void RasterizeBlocks(const Edge (&edges)[3], const ScreenRect& bounds, const Triangle<const V&>& triangle, const RasterContext& context);
+
+	// coarse depth rejection of a whole triangle against the tiles its bounding box overlaps inside rect
+	bool IsOccluded(const TriangleRef& triangle, const ScreenRect& rect, const RasterContext& context);
+
+	// depth the coarse tests compare against the tile maxima for a triangle (or block) nearest at zMin
+	// the shade pass keeps pixels exactly at the stored depth while the tests are strict and the bounds
+	// round differently than the interpolated depths, so its bound is pulled in by CullMargin and one
+	// unorm step
+	float GetCullDepth(float zMin, const RasterContext& context) const;
+
+	// depth cull up to MaxSpanWidth pixels of a scanline at once against one sample of the z-buffer,
+	// store the triangle id in the visibility buffer for the covered pixels that passed and return their mask
+	// pos is the interpolated position at the sample of pixel (x, y), dpos its change per pixel
+	unsigned int DepthTestSpan(int x, int y, int count, const DirectX::XMFLOAT4& pos, const DirectX::XMFLOAT4& dpos, unsigned int coverage, int sample, const RasterContext& context, float* w);
+
+	// depth cull a span and invoke ps for the covered pixels that passed and write them to screen
+	// the pixel's attribute derivatives are derived from the plane equations ditdx / ditdy
+	void DrawSpan(int x, int y, int count, const VSOutput& it, const VSOutput& ditdx, const VSOutput& ditdy, unsigned int coverage, const RasterContext& context);
+
+	// === 2x2 quad shading ===
+	//   lane i of a quad is pixel (x + (i & 1), y + (i >> 1)), quads start at even coordinates
+	//   lanes without samples are helpers: their attributes are computed for the derivatives but never written
+	//
+	// shades the quads of two rows of a span, masks[row][sample] are the pixels whose sample passed in row y + row
+	// it is the (not yet perspective divided) interpolant at pixel (x, y)
+	void ShadeQuads(int x, int y, int count, const unsigned int (&masks)[2][MaxSamples], const VSOutput& it, const VSOutput& ditdx, const VSOutput& ditdy, PixelShader& ps);
+
+	// depth only interpolants have nothing to shade
+	template<typename V>
+	void ShadeQuads(int x, int y, int count, const unsigned int (&masks)[2][MaxSamples], const V& it, const V& ditdx, const V& ditdy, PixelShader& ps) {}
+
+	// invokes ps with the attributes of the four lanes and the quad's ddx / ddy,
+	// writes every lane to the samples in its laneSamples mask
+	void ShadeQuad(int x, int y, const unsigned int (&laneSamples)[4], const VSOutput& it, const VSOutput& ditdx, const VSOutput& ditdy, PixelShader& ps);
+
+	// attribute plane equations: change in interpolant for every 1 change in x and in y
+	// returns false for degenerate (zero area) triangles
+	template<typename V>
+	static bool SetupGradients(const Triangle<const V&>& triangle, V& ditdx, V& ditdy);
+
+	// keeps a screen space triangle for the rest of the frame and returns its id
+	unsigned int RecordTriangle(const TriangleRef& triangle);
+
+	// === visibility buffer shading ===
+	//
+	// reconstructs attributes of the visible triangle and runs its pixel shader for every pixel of the rows
+	// yStart must be even so the quads of neighbouring bands do not overlap
+	void ResolveVisibility(int yStart, int yEnd);
+
+	// === sort-middle binning ===
+	//
+	// records a screen space triangle in every tile its bounding box overlaps
+	void BinTriangle(const TriangleRef& triangle);
+
+	// rasterizes the triangles of one tile in submission order
+	void RasterizeTile(size_t tileIndex);
+
+	// rasterizes a recorded triangle inside rect with the current raster mode
+	// (Scanline always covers the whole target, it is never binned)
+	void DrawFrameTriangle(size_t triangleIndex, RasterPass pass, const ScreenRect& rect);
+
+	bool IsBinning() const;
+
+	// binned, visibility buffer and depth prepass triangles are shaded after Draw returns
+	bool IsDeferred() const;
+
+	// rasterizes the binned triangles, shades the visibility buffer and runs both passes of the depth prepass
+	void FlushTriangles();
+
+	// BeginFrame without touching the render target
+	void ResetFrame();
+
+	// samples the frame is drawn with from the requested count and the modes
+	void UpdateSamples();
+
+	// color written to the samples in sampleMask of pixel (x, y), straight to the pixel when single sampled
+	void PutPixel(int x, int y, unsigned int color, unsigned int sampleMask = 1u);
+
+	// copies the render target pixels of a tile into all their samples
+	void LoadSamples(size_t tileIndex);
+
+	// fills the samples of a tile flagged by a fast clear with the clear color
+	void FillSamples(size_t tileIndex);
+
+	// averages the samples of the pixels of a tile into the render target
+	void ResolveSamples(size_t tileIndex);
+
+	// === render target tiles ===
+	//   tile i covers the pixels of bin i, TileSize rows of TileSize colors one after the other
+	//
+	// color written to pixel (x, y) of the render target (or its tile)
+	void WritePixel(int x, int y, unsigned int color);
+
+	// copies the pixels of a tile from the render target into the color tiles
+	void LoadTile(size_t tileIndex);
+
+	// fills a color tile flagged by a fast clear with the clear color
+	void FillTile(size_t tileIndex);
+
+	// copies the color tile back into the render target
+	void ResolveTile(size_t tileIndex);
+
+	// runs job(tileIndex) for every tile, on the thread pool if there is one
+	void ForEachTile(const std::function<void(size_t)>& job);
+public:
+	Effect									effect;
+
+private:
+	
+	std::shared_ptr<NDCScreenTransformer>	pst;
+	std::shared_ptr<ZBuffer>				pZb;
+
+	TextureClass&							mSysBuff;
+
+	RasterMode								mRasterMode = RasterMode::Scanline;
+	ShadingMode								mShadingMode = ShadingMode::Forward;
+	TargetLayout							mTargetLayout = TargetLayout::Linear;
+
+	// colors of the frame in Tiled layout
+	std::vector<unsigned int>				mColorTiles;
+	// per tile, set while the tile only holds mClearColor and its pixels were not written yet
+	// (its samples while multisampled, the resolve writes every pixel then)
+	// (bytes rather than bits, tiles are owned by different threads)
+	std::vector<unsigned char>				mColorTileCleared;
+	unsigned int							mClearColor = 0u;
+
+	// requested samples per pixel, and the samples the frame is drawn with
+	unsigned int							mSampleCount = 1u;
+	int										mSamples = 1;
+	// colors while multisampled, tiles like mColorTiles with the MaxSamples colors of a pixel one after the other
+	std::vector<unsigned int>				mSampleColors;
+
+	// triangle id per pixel, NoTriangle where nothing was drawn
+	std::vector<unsigned int>				mVisibility;
+
+	SimdLevel								mMaxSimdLevel;
+	SimdLevel								mSimdLevel;
+	DepthSpanKernel							mDepthSpan;
+	DepthSpanKernel							mDepthEqualSpan;
+
+	// binning state, tiles own disjoint regions of the z-buffer and the render target
+	std::unique_ptr<ThreadPool>							mThreadPool;
+	int													mTilesX;
+	int													mTilesY;
+	std::vector<FrameArray<size_t>>						mBins;
+	FrameArray<PixelShader>								mDrawStates;
+
+	// triangles referenced by the bins and the visibility buffer
+	FrameArray<FrameTriangle>							mFrameTriangles;
+
+	// backs every per-frame allocation of the pipeline
+	FrameArena											mFrameArena;
+
+	// post-transform vertex cache of the current draw, allocated from the frame arena
+	// every vertex is transformed, classified and projected once no matter how many triangles share it
+	VSOutput*											mVertices = nullptr;
+	unsigned int*										mVertexClipCodes = nullptr;
+	// screen space copies, only valid for vertices in front of the near plane
+	VSOutput*											mScreenVertices = nullptr;
+	// chunks still being shaded while the triangles of the draw are assembled, null when shaded inline
+	VertexJobs*											mVertexJobs = nullptr;
+
+	int										mWidth;
+	int										mHeight;
+};
+
+template<class Effect>
+constexpr unsigned int Pipeline<Effect>::NoTriangle;
+
+template<class Effect>
+constexpr size_t Pipeline<Effect>::NoVertex;
+
+template<class Effect>
+constexpr size_t Pipeline<Effect>::VertexChunkSize;
+
+template<class Effect>
+constexpr float Pipeline<Effect>::CullMargin;
+
+template<class Effect>
+constexpr int Pipeline<Effect>::SampleOffsetX[MaxSamples];
+
+template<class Effect>
+constexpr int Pipeline<Effect>::SampleOffsetY[MaxSamples];
+
+template<class Effect>
+Pipeline<Effect>::Pipeline(TextureClass& sysT) : mSysBuff(sysT) {
+
+	mWidth		= sysT.GetWidth();
+	mHeight		= sysT.GetHeight();
+	pZb			= std::make_shared<ZBuffer>(mWidth, mHeight);
+	pst			= std::make_shared<NDCScreenTransformer>(mWidth, mHeight);
+
+	mTilesX		= (mWidth + TileSize - 1) / TileSize;
+	mTilesY		= (mHeight + TileSize - 1) / TileSize;
+	mBins.resize(mTilesX * mTilesY);
+
+	mMaxSimdLevel	= DetectSimdLevel();
+	SetSimdLevel(mMaxSimdLevel);
+}
+
+template<class Effect>
+void Pipeline<Effect>::Draw(IndexedTriangleList& triList) {
+
+	// binned and visibility buffer triangles are shaded later, so keep the shader state of this draw around
+	if (IsDeferred()) {
+		mDrawStates.PushBack(mFrameArena, effect.ps);
+	}
+
+	// streams follow the vertices, the first draw after a change rebuilds them
+	if (triList.HasStaleStreams()) {
+		triList.BuildStreams();
+	}
+	const bool hasStreams = triList.HasStreams() && !triList.vertices.empty();
+	ProcessVertices(triList.vertices, hasStreams ? &triList.streams : nullptr, triList.indices);
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetRasterMode(RasterMode mode) {
+
+	// binned triangles must be rasterized with the mode they were binned for
+	EndFrame();
+
+	mRasterMode = mode;
+	UpdateSamples();
+}
+
+template<class Effect>
+typename Pipeline<Effect>::RasterMode Pipeline<Effect>::GetRasterMode() const {
+	return mRasterMode;
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetShadingMode(ShadingMode mode) {
+
+	// finish shading whatever was recorded with the previous mode
+	EndFrame();
+
+	mShadingMode = mode;
+	if (mShadingMode == ShadingMode::VisibilityBuffer) {
+		mVisibility.assign(mWidth * mHeight, NoTriangle);
+	}
+	else {
+		mVisibility = std::vector<unsigned int>();
+	}
+	UpdateSamples();
+}
+
+template<class Effect>
+typename Pipeline<Effect>::ShadingMode Pipeline<Effect>::GetShadingMode() const {
+	return mShadingMode;
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetThreadCount(unsigned int threadCount) {
+
+	// bins are recorded against the current pool, flush them before switching
+	EndFrame();
+
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	if (threadCount > 1) {
+		mThreadPool = std::make_unique<ThreadPool>(threadCount);
+	}
+	else {
+		mThreadPool.reset();
+	}
+}
+
+template<class Effect>
+unsigned int Pipeline<Effect>::GetThreadCount() const {
+	return mThreadPool ? mThreadPool->GetThreadCount() : 1u;
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetSimdLevel(SimdLevel level) {
+	mSimdLevel = std::min(level, mMaxSimdLevel);
+	mDepthSpan = SelectDepthSpanKernel(mSimdLevel, pZb->GetFormat());
+	mDepthEqualSpan = SelectDepthSpanKernel(mSimdLevel, pZb->GetFormat(), DepthTest::Equal);
+}
+
+template<class Effect>
+SimdLevel Pipeline<Effect>::GetSimdLevel() const {
+	return mSimdLevel;
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetTargetLayout(TargetLayout layout) {
+	if (layout == mTargetLayout) {
+		return;
+	}
+
+	// puts everything drawn so far in the render target
+	EndFrame();
+
+	mTargetLayout = layout;
+	if (mTargetLayout == TargetLayout::Tiled) {
+		// resolves copy whole rows of a tile into the target
+		mSysBuff.SetLayout(TextureClass::TexelLayout::Linear);
+		pZb->SetLayout(ZBuffer::Layout::Tiled);
+		mColorTiles.resize(mBins.size() * TileSize * TileSize);
+		mColorTileCleared.resize(mBins.size());
+
+		// the rest of the frame is drawn into the tiles (or resolved into them, the flags stay with the samples)
+		if (mSamples == 1) {
+			ForEachTile([this](size_t tileIndex) {
+				LoadTile(tileIndex);
+			});
+		}
+	}
+	else {
+		pZb->SetLayout(ZBuffer::Layout::Linear);
+		mColorTiles = std::vector<unsigned int>();
+		if (mSamples == 1) {
+			mColorTileCleared = std::vector<unsigned char>();
+		}
+	}
+}
+
+template<class Effect>
+typename Pipeline<Effect>::TargetLayout Pipeline<Effect>::GetTargetLayout() const {
+	return mTargetLayout;
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetDepthFormat(DepthFormat format) {
+	pZb->SetFormat(format);
+	mDepthSpan = SelectDepthSpanKernel(mSimdLevel, format);
+	mDepthEqualSpan = SelectDepthSpanKernel(mSimdLevel, format, DepthTest::Equal);
+}
+
+template<class Effect>
+DepthFormat Pipeline<Effect>::GetDepthFormat() const {
+	return pZb->GetFormat();
+}
+
+template<class Effect>
+void Pipeline<Effect>::SetSampleCount(unsigned int count) {
+
+	// puts everything drawn so far in the render target
+	EndFrame();
+
+	mSampleCount = count >= (unsigned int)MaxSamples ? (unsigned int)MaxSamples : 1u;
+	UpdateSamples();
+}
+
+template<class Effect>
+unsigned int Pipeline<Effect>::GetSampleCount() const {
+	return mSampleCount;
+}
+
+template<class Effect>
+void Pipeline<Effect>::UpdateSamples() {
+
+	// the scanline walk and the visibility buffer work on whole pixels
+	const bool multisampled = mSampleCount > 1u && mRasterMode != RasterMode::Scanline && mShadingMode != ShadingMode::VisibilityBuffer;
+	const int samples = multisampled ? int(mSampleCount) : 1;
+	if (samples == mSamples) {
+		return;
+	}
+
+	mSamples = samples;
+	pZb->SetSampleCount(mSamples);
+	if (mSamples > 1) {
+		// the frame continues from what the render target holds
+		mSampleColors.resize(mBins.size() * TileSize * TileSize * MaxSamples);
+		mColorTileCleared.resize(mBins.size());
+		ForEachTile([this](size_t tileIndex) {
+			LoadSamples(tileIndex);
+		});
+	}
+	else {
+		mSampleColors = std::vector<unsigned int>();
+		if (mTargetLayout != TargetLayout::Tiled) {
+			mColorTileCleared = std::vector<unsigned char>();
+		}
+	}
+}
+
+template<class Effect>
+const FrameArena& Pipeline<Effect>::GetFrameArena() const {
+	return mFrameArena;
+}
+
+template<class Effect>
+void Pipeline<Effect>::BeginFrame() {
+	ResetFrame();
+
+	// the frame is drawn over whatever the render target holds
+	// (multisampled color tiles need no loading, the resolve writes all of them)
+	if (mSamples > 1) {
+		ForEachTile([this](size_t tileIndex) {
+			LoadSamples(tileIndex);
+		});
+	}
+	else if (mTargetLayout == TargetLayout::Tiled) {
+		ForEachTile([this](size_t tileIndex) {
+			LoadTile(tileIndex);
+		});
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::BeginFrame(ColorIntegers clearColor) {
+	ResetFrame();
+
+	// tiles (their samples when multisampled) are filled when they are first drawn to,
+	// the resolve writes the clear color straight to the target for the others
+	if (mSamples > 1 || mTargetLayout == TargetLayout::Tiled) {
+		mClearColor = clearColor.dword;
+		std::fill(mColorTileCleared.begin(), mColorTileCleared.end(), (unsigned char)1u);
+	}
+	else {
+		mSysBuff.Clear(clearColor);
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::ResetFrame() {
+	pZb->Clear();
+
+	// everything allocated last frame goes back to the arena
+	for (auto& bin : mBins) {
+		bin.Clear();
+	}
+	mFrameTriangles.Clear();
+	mDrawStates.Clear();
+	mVertices = nullptr;
+	mVertexClipCodes = nullptr;
+	mScreenVertices = nullptr;
+	mFrameArena.Reset();
+
+	// the ids of the last frame (or of one that was begun and never ended) point at triangles that are gone now
+	if (mShadingMode == ShadingMode::VisibilityBuffer) {
+		std::fill(mVisibility.begin(), mVisibility.end(), NoTriangle);
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::EndFrame() {
+	FlushTriangles();
+
+	if (mSamples > 1) {
+		ForEachTile([this](size_t tileIndex) {
+			ResolveSamples(tileIndex);
+		});
+	}
+
+	// the render target only gets to see the colors once everything is drawn
+	if (mTargetLayout == TargetLayout::Tiled) {
+		ForEachTile([this](size_t tileIndex) {
+			ResolveTile(tileIndex);
+		});
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::FlushTriangles() {
+	if (mFrameTriangles.Empty()) {
+		return;
+	}
+
+	if (IsBinning()) {
+		// every tile is an independent job, triangles keep their submission order inside a tile
+		mThreadPool->ParallelFor(mBins.size(), [this](size_t tileIndex) {
+			RasterizeTile(tileIndex);
+		});
+
+		for (auto& bin : mBins) {
+			bin.Clear();
+		}
+	}
+	else if (mShadingMode == ShadingMode::DepthPrepass) {
+		// the depth of the whole frame first, then shade what ended up in front
+		const ScreenRect screen = { 0, 0, mWidth, mHeight };
+		for (size_t triangleIndex = 0; triangleIndex < mFrameTriangles.Size(); triangleIndex++) {
+			DrawFrameTriangle(triangleIndex, RasterPass::DepthOnly, screen);
+		}
+		for (size_t triangleIndex = 0; triangleIndex < mFrameTriangles.Size(); triangleIndex++) {
+			DrawFrameTriangle(triangleIndex, RasterPass::Shade, screen);
+		}
+	}
+
+	if (mShadingMode == ShadingMode::VisibilityBuffer) {
+		// shade the visible pixels once, in bands of rows when there are threads to share them
+		if (mThreadPool) {
+			mThreadPool->ParallelFor(mTilesY, [this](size_t band) {
+				ResolveVisibility(int(band) * TileSize, std::min(int(band + 1) * TileSize, mHeight));
+			});
+		}
+		else {
+			ResolveVisibility(0, mHeight);
+		}
+	}
+
+	mFrameTriangles.Clear();
+	mDrawStates.Clear();
+}
+
+template<class Effect>
+void Pipeline<Effect>::ProcessVertices(std::vector<Vertex>& vertices, const VertexStreams* streams, std::vector<size_t>& indices) {
+
+	// vertex cache for this draw, from the frame arena
+	const size_t count = vertices.size();
+	mVertices = mFrameArena.Allocate<VSOutput>(count);
+	mVertexClipCodes = mFrameArena.Allocate<unsigned int>(count);
+	mScreenVertices = mFrameArena.Allocate<VSOutput>(count);
+
+	// not worth waking the workers for
+	if (!mThreadPool || count < ParallelVertexThreshold) {
+		ShadeVertices(vertices, streams, 0, count);
+
+		// assemble triangles from stream of indices and cached vertices
+		AssembleTriangles(indices);
+		return;
+	}
+
+	VertexJobs jobs;
+	jobs.vertices = &vertices;
+	jobs.streams = streams;
+	jobs.indices = &indices;
+	jobs.chunkCount = (count + VertexChunkSize - 1) / VertexChunkSize;
+	jobs.nextChunk = 0;
+	jobs.chunkDone = mFrameArena.Allocate<std::atomic<bool>>(jobs.chunkCount);
+	for (size_t chunk = 0; chunk < jobs.chunkCount; chunk++) {
+		new (&jobs.chunkDone[chunk]) std::atomic<bool>(false);
+	}
+	mVertexJobs = &jobs;
+
+	// one job assembles triangles in order as soon as the chunks holding their vertices are done,
+	// all others shade chunks (assembly and binning stay on a single thread)
+	mThreadPool->ParallelFor(mThreadPool->GetThreadCount(), [this](size_t job) {
+		if (job == 0) {
+			AssembleTriangles(*mVertexJobs->indices);
+		}
+		else {
+			while (RunVertexChunk()) {}
+		}
+	});
+
+	mVertexJobs = nullptr;
+}
+
+template<class Effect>
+void Pipeline<Effect>::ShadeVertices(std::vector<Vertex>& vertices, const VertexStreams* streams, size_t begin, size_t end) {
+
+	// transform vertices with vs, a whole batch at a time when the mesh has vertex streams
+	if (streams) {
+		effect.vs(*streams, begin, end, mVertices, mSimdLevel);
+	}
+	else {
+		for (size_t i = begin; i < end; i++) {
+			mVertices[i] = effect.vs(vertices[i]);
+		}
+	}
+
+	for (size_t i = begin; i < end; i++) {
+		mVertexClipCodes[i] = ComputeClipCodes(mVertices[i].pos);
+
+		// perspective divide and screen transform once per vertex,
+		// vertices behind the near plane are only ever drawn through the clipper
+		if (!(mVertexClipCodes[i] & ClipNear)) {
+			mScreenVertices[i] = mVertices[i];
+			pst->Transform(mScreenVertices[i]);
+		}
+	}
+}
+
+template<class Effect>
+bool Pipeline<Effect>::RunVertexChunk() {
+	const size_t chunk = mVertexJobs->nextChunk++;
+	if (chunk >= mVertexJobs->chunkCount) {
+		return false;
+	}
+
+	const size_t begin = chunk * VertexChunkSize;
+	const size_t end = std::min(begin + VertexChunkSize, mVertexJobs->vertices->size());
+	ShadeVertices(*mVertexJobs->vertices, mVertexJobs->streams, begin, end);
+
+	mVertexJobs->chunkDone[chunk].store(true, std::memory_order_release);
+	return true;
+}
+
+template<class Effect>
+void Pipeline<Effect>::WaitForVertex(size_t index) {
+	const std::atomic<bool>& done = mVertexJobs->chunkDone[index / VertexChunkSize];
+	while (!done.load(std::memory_order_acquire)) {
+		// help out rather than spin, once every chunk is claimed the missing one is almost done
+		if (!RunVertexChunk()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::AssembleTriangles(std::vector<size_t>& indices) {
+
+	//DirectX::XMVECTOR eyepos = DirectX::XMVector4Transform(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), DirectX::XMLoadFloat4x4(&effect.vs.GetProj()));
+	DirectX::XMFLOAT4X4& proj = effect.vs.GetProj();
+	DirectX::XMVECTOR eyepos = DirectX::XMVectorSet(proj(3, 0), proj(3, 1), proj(3, 2), 1.0f);
+
+	// assemble triangles in the stream and process
+	for (size_t i = 0, end = indices.size() / 3; i < end; i++) {
+
+		// determine triangle vertices via indexing
+		const size_t i0 = indices[i * 3];
+		const size_t i1 = indices[i * 3 + 1];
+		const size_t i2 = indices[i * 3 + 2];
+
+		// the vertices may still be shaded by the thread pool
+		if (mVertexJobs) {
+			WaitForVertex(i0);
+			WaitForVertex(i1);
+			WaitForVertex(i2);
+		}
+
+		const VSOutput& v0 = mVertices[i0];
+		const VSOutput& v1 = mVertices[i1];
+		const VSOutput& v2 = mVertices[i2];
+
+		DirectX::XMVECTOR vec1 = DirectX::operator-(DirectX::XMLoadFloat4(&v1.pos), DirectX::XMLoadFloat4(&v0.pos));
+		DirectX::XMVECTOR vec2 = DirectX::operator-(DirectX::XMLoadFloat4(&v2.pos), DirectX::XMLoadFloat4(&v0.pos));
+		DirectX::XMVECTOR norm = DirectX::XMVector3Cross(vec1, vec2);
+
+		DirectX::XMVECTOR eye = DirectX::operator-(DirectX::XMLoadFloat4(&v2.pos), eyepos);
+
+		// cull backfacing triangles with cross product (%) shenanigans
+		if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(norm, eye)) <= 0.0f) {
+			// process 3 vertices into a triangle
+			ProcessTriangle(i0, i1, i2, i);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::ProcessTriangle(size_t i0, size_t i1, size_t i2, size_t triangle_index) {
+	const VSOutput& v0 = mVertices[i0];
+	const VSOutput& v1 = mVertices[i1];
+	const VSOutput& v2 = mVertices[i2];
+
+	// generate triangle from 3 vertices using gs
+	const TriangleRef t = effect.gs(v0, v1, v2, triangle_index);
+
+	// keep track of which cached vertices the gs passed on
+	const size_t indices[3] = {
+		&t.v0 == &v0 ? i0 : &t.v0 == &v1 ? i1 : &t.v0 == &v2 ? i2 : NoVertex,
+		&t.v1 == &v0 ? i0 : &t.v1 == &v1 ? i1 : &t.v1 == &v2 ? i2 : NoVertex,
+		&t.v2 == &v0 ? i0 : &t.v2 == &v1 ? i1 : &t.v2 == &v2 ? i2 : NoVertex
+	};
+
+	// and send to clipper
+	ClipCullTriangle(t, indices);
+}
+
+template<class Effect>
+void Pipeline<Effect>::ClipCullTriangle(const TriangleRef& t, const size_t (&indices)[3]) {
+
+	const unsigned int codes0 = indices[0] != NoVertex ? mVertexClipCodes[indices[0]] : ComputeClipCodes(t.v0.pos);
+	const unsigned int codes1 = indices[1] != NoVertex ? mVertexClipCodes[indices[1]] : ComputeClipCodes(t.v1.pos);
+	const unsigned int codes2 = indices[2] != NoVertex ? mVertexClipCodes[indices[2]] : ComputeClipCodes(t.v2.pos);
+
+	// cull tests: all three vertices outside the same plane of the view volume
+	const unsigned int viewMask = (1u << GuardBandCodeShift) - 1u;
+	if (codes0 & codes1 & codes2 & viewMask) {
+		return;
+	}
+
+	// planes the triangle actually crosses, x and y only count when leaving the guard band
+	const unsigned int crossed = (codes0 | codes1 | codes2) >> GuardBandCodeShift;
+
+	// no clipping necessary, parts outside the screen are skipped by the rasterizer
+	if (crossed == 0u) {
+		VSOutput scratch[3];
+		const TriangleRef screen = {
+			GetScreenVertex(t.v0, indices[0], scratch[0]),
+			GetScreenVertex(t.v1, indices[1], scratch[1]),
+			GetScreenVertex(t.v2, indices[2], scratch[2])
+		};
+		DrawScreenTriangle(screen);
+		return;
+	}
+
+	// clipping routine, the polygon ping-pongs between two fixed size buffers
+	ClipPolygon polygons[2];
+	polygons[0].vertices[0] = t.v0;
+	polygons[0].vertices[1] = t.v1;
+	polygons[0].vertices[2] = t.v2;
+	polygons[0].count = 3;
+
+	int current = 0;
+	for (unsigned int plane = ClipLeft; plane <= ClipFar; plane <<= 1) {
+		if (crossed & plane) {
+			ClipPolygonAgainstPlane(polygons[current], polygons[current ^ 1], plane);
+			current ^= 1;
+			if (polygons[current].count < 3) {
+				return;
+			}
+		}
+	}
+
+	// perspective divide and screen transform once per polygon vertex
+	ClipPolygon& clipped = polygons[current];
+	for (int i = 0; i < clipped.count; i++) {
+		pst->Transform(clipped.vertices[i]);
+	}
+
+	// draw the clipped polygon as a triangle fan, winding is preserved
+	for (int i = 1; i + 1 < clipped.count; i++) {
+		const TriangleRef fan = { clipped.vertices[0], clipped.vertices[i], clipped.vertices[i + 1] };
+		DrawScreenTriangle(fan);
+	}
+}
+
+template<class Effect>
+unsigned int Pipeline<Effect>::ComputeOutcode(const DirectX::XMFLOAT4& pos, float band) {
+	unsigned int outcode = 0u;
+
+	if (pos.x < -band * pos.w) {
+		outcode |= ClipLeft;
+	}
+	if (pos.x > band * pos.w) {
+		outcode |= ClipRight;
+	}
+	if (pos.y < -band * pos.w) {
+		outcode |= ClipBottom;
+	}
+	if (pos.y > band * pos.w) {
+		outcode |= ClipTop;
+	}
+	if (pos.z < 0.0f) {
+		outcode |= ClipNear;
+	}
+	if (pos.z > pos.w) {
+		outcode |= ClipFar;
+	}
+
+	return outcode;
+}
+
+template<class Effect>
+unsigned int Pipeline<Effect>::ComputeClipCodes(const DirectX::XMFLOAT4& pos) {
+	return ComputeOutcode(pos, 1.0f) | (ComputeOutcode(pos, GuardBand) << GuardBandCodeShift);
+}
+
+template<class Effect>
+float Pipeline<Effect>::ClipDistance(const DirectX::XMFLOAT4& pos, unsigned int plane) {
+	switch (plane) {
+	case ClipLeft:
+		return pos.x + GuardBand * pos.w;
+	case ClipRight:
+		return GuardBand * pos.w - pos.x;
+	case ClipBottom:
+		return pos.y + GuardBand * pos.w;
+	case ClipTop:
+		return GuardBand * pos.w - pos.y;
+	case ClipNear:
+		return pos.z;
+	default:
+		return pos.w - pos.z;
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::ClipPolygonAgainstPlane(const ClipPolygon& in, ClipPolygon& out, unsigned int plane) {
+	out.count = 0;
+
+	for (int i = 0; i < in.count; i++) {
+		const VSOutput& a = in.vertices[i];
+		const VSOutput& b = in.vertices[(i + 1) % in.count];
+		const float da = ClipDistance(a.pos, plane);
+		const float db = ClipDistance(b.pos, plane);
+
+		// keep vertices on the inner side
+		if (da >= 0.0f) {
+			out.vertices[out.count++] = a;
+		}
+
+		// edge crosses the plane, interpolate the vertex on it
+		if ((da >= 0.0f) != (db >= 0.0f)) {
+			const float alpha = da / (da - db);
+			out.vertices[out.count++] = a + (b - a) * alpha;
+		}
+	}
+}
+
+template<class Effect>
+const typename Pipeline<Effect>::VSOutput& Pipeline<Effect>::GetScreenVertex(const VSOutput& v, size_t index, VSOutput& scratch) const {
+	if (index != NoVertex) {
+		return mScreenVertices[index];
+	}
+
+	scratch = v;
+	return pst->Transform(scratch);
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawScreenTriangle(const TriangleRef& triangle) {
+
+	// draw the triangle
+	if (IsBinning()) {
+		BinTriangle(triangle);
+		return;
+	}
+
+	// the depth prepass needs the whole frame before it can shade anything
+	if (mShadingMode == ShadingMode::DepthPrepass) {
+		RecordTriangle(triangle);
+		return;
+	}
+
+	RasterContext context = { &effect.ps, NoTriangle, RasterPass::Color };
+	if (mShadingMode == ShadingMode::VisibilityBuffer) {
+		context = { nullptr, RecordTriangle(triangle), RasterPass::Color };
+	}
+
+	if (mRasterMode == RasterMode::HalfSpace) {
+		DrawTriangleHalfSpace(triangle, context, { 0, 0, mWidth, mHeight });
+	}
+	else if (mRasterMode == RasterMode::FixedPoint) {
+		DrawTriangleFixedPoint(triangle, context, { 0, 0, mWidth, mHeight });
+	}
+	else {
+		DrawTriangle(triangle, context);
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawTriangle(const TriangleRef& triangle, const RasterContext& context) {
+
+	// using pointers so we can swap (for sorting purposes)
+	const DirectX::XMFLOAT4* pv0 = &triangle.v0.pos;
+	const DirectX::XMFLOAT4* pv1 = &triangle.v1.pos;
+	const DirectX::XMFLOAT4* pv2 = &triangle.v2.pos;
+
+	// skip triangles hidden behind everything already drawn
+	if (IsOccluded(triangle, { 0, 0, mWidth, mHeight }, context)) {
+		return;
+	}
+
+	// attribute plane equations, set up once for the whole triangle
+	AttributePlanes planes;
+	planes.it0 = triangle.v0;
+	if (!SetupGradients(triangle, planes.ditdx, planes.ditdy)) {
+		return;
+	}
+
+	// sorting vertices by y
+	if (pv1->y < pv0->y) std::swap(pv0, pv1);
+	if (pv2->y < pv1->y) std::swap(pv1, pv2);
+	if (pv1->y < pv0->y) std::swap(pv0, pv1);
+
+	// natural flat top
+	if (pv0->y == pv1->y) {
+
+		// sorting top vertices by x
+		if (pv1->x < pv0->x) std::swap(pv0, pv1);
+		DrawFlatTopTriangle(*pv0, *pv1, *pv2, planes, context);
+	}
+	// natural flat bottom
+	else if (pv1->y == pv2->y) {
+
+		// sorting bottom vertices by x
+		if (pv2->x < pv1->x) std::swap(pv1, pv2);
+		DrawFlatBottomTriangle(*pv0, *pv1, *pv2, planes, context);
+	}
+	// general triangle
+	else {
+
+		// find splitting vertex, only its position is needed
+		float alphaSplit = (pv1->y - pv0->y) / (pv2->y - pv0->y);
+		DirectX::XMFLOAT4 vi = *pv1;
+		vi.x = pv0->x + (pv2->x - pv0->x) * alphaSplit;
+
+		if (pv1->x < vi.x) // major right
+		{
+			DrawFlatBottomTriangle(*pv0, *pv1, vi, planes, context);
+			DrawFlatTopTriangle(*pv1, vi, *pv2, planes, context);
+		}
+		else // major left
+		{
+			DrawFlatBottomTriangle(*pv0, vi, *pv1, planes, context);
+			DrawFlatTopTriangle(vi, *pv1, *pv2, planes, context);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawFlatTopTriangle(const DirectX::XMFLOAT4& p0, const DirectX::XMFLOAT4& p1, const DirectX::XMFLOAT4& p2, const AttributePlanes& planes, const RasterContext& context) {
+	// calulcate dx / dy of both edges
+	// change in x for every 1 change in y
+	float delta_y = p2.y - p0.y;
+	float dxdy0 = (p2.x - p0.x) / delta_y;
+	float dxdy1 = (p2.x - p1.x) / delta_y;
+
+	// call the flat triangle render routine, right edge starts at p1
+	DrawFlatTriangle(p0, p2, dxdy0, dxdy1, p1.x, planes, context);
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawFlatBottomTriangle(const DirectX::XMFLOAT4& p0, const DirectX::XMFLOAT4& p1, const DirectX::XMFLOAT4& p2, const AttributePlanes& planes, const RasterContext& context) {
+	// calulcate dx / dy of both edges
+	// change in x for every 1 change in y
+	float delta_y = p2.y - p0.y;
+	float dxdy0 = (p1.x - p0.x) / delta_y;
+	float dxdy1 = (p2.x - p0.x) / delta_y;
+
+	// call the flat triangle render routine, right edge starts at p0
+	DrawFlatTriangle(p0, p2, dxdy0, dxdy1, p0.x, planes, context);
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawFlatTriangle(const DirectX::XMFLOAT4& p0, const DirectX::XMFLOAT4& p2, float dxdy0, float dxdy1, float xEdge1, const AttributePlanes& planes, const RasterContext& context) {
+
+	// calculate start and end scanlines
+	int yStart = std::max<float>((int)std::ceil(p0.y - 0.5f), 0);
+	int yEnd = std::min<float>((int)std::ceil(p2.y - 0.5f), (int)mHeight - 1); // the scanline AFTER the last line drawn
+
+	// do edge prestep, left edge always starts at p0
+	float xEdge0 = p0.x + dxdy0 * (float(yStart) + 0.5f - p0.y);
+	xEdge1 += dxdy1 * (float(yStart) + 0.5f - p0.y);
+
+	const VSOutput& it0 = planes.it0;
+	const VSOutput diSpan = planes.ditdx * float(MaxSpanWidth);
+
+	for (int y = yStart; y < yEnd; y++, xEdge0 += dxdy0, xEdge1 += dxdy1) {
+
+		// calculate start and end pixels
+		int xStart = std::max<float>((int)std::ceil(xEdge0 - 0.5f), 0);
+		int xEnd = std::min<float>((int)std::ceil(xEdge1 - 0.5f), (int)mWidth - 1); // the pixel AFTER the last pixel drawn
+
+		// scanline interpolant at the first pixel, straight from the plane equations
+		// (evaluated from it0 every scanline rather than stepped, so errors do not pile up over tall triangles)
+		auto iLine = it0 + planes.ditdy * (float(y) + 0.5f - it0.pos.y) + planes.ditdx * (float(xStart) + 0.5f - it0.pos.x);
+
+		// walk the scanline in spans of pixels handled by one kernel call,
+		// a span ends early where the z-buffer row continues in the next storage tile
+		for (int x = xStart, count; x < xEnd; x += count, iLine += count == MaxSpanWidth ? diSpan : planes.ditdx * float(count)) {
+			count = std::min(std::min(MaxSpanWidth, xEnd - x), pZb->GetContiguousPixels(x));
+
+			// skip spans that are behind the farthest depth of the tiles they cross
+			const float zMin = std::min(iLine.pos.z, iLine.pos.z + planes.ditdx.pos.z * float(count - 1));
+			if (pZb->IsOccluded(x, y, x + count, y + 1, GetCullDepth(zMin, context))) {
+				continue;
+			}
+
+			DrawSpan(x, y, count, iLine, planes.ditdx, planes.ditdy, ~0u, context);
+		}
+	}
+}
+
+template<class Effect>
+template<typename V>
+void Pipeline<Effect>::DrawTriangleHalfSpace(const Triangle<const V&>& triangle, const RasterContext& context, const ScreenRect& rect) {
+
+	// using pointers so we can swap (for winding purposes)
+	const V* pv0 = &triangle.v0;
+	const V* pv1 = &triangle.v1;
+	const V* pv2 = &triangle.v2;
+
+	// twice the signed screen space area, skip degenerate triangles
+	const float area = (pv2->pos.x - pv0->pos.x) * (pv1->pos.y - pv0->pos.y) - (pv2->pos.y - pv0->pos.y) * (pv1->pos.x - pv0->pos.x);
+	if (area == 0.0f) {
+		return;
+	}
+
+	// clipping can flip the winding, order vertices so the interior is on the positive side of every edge
+	if (area < 0.0f) {
+		std::swap(pv1, pv2);
+	}
+
+	const EdgeEquation edges[3] = {
+		EdgeEquation(pv0->pos.x, pv0->pos.y, pv1->pos.x, pv1->pos.y),
+		EdgeEquation(pv1->pos.x, pv1->pos.y, pv2->pos.x, pv2->pos.y),
+		EdgeEquation(pv2->pos.x, pv2->pos.y, pv0->pos.x, pv0->pos.y)
+	};
+
+	// bounding box of pixel centers (of pixels with samples inside when multisampled), clamped to the target rect
+	const float reach = mSamples > 1 ? float(SampleReach) / 16.0f : 0.0f;
+	const float minX = std::min(std::min(pv0->pos.x, pv1->pos.x), pv2->pos.x) - reach;
+	const float maxX = std::max(std::max(pv0->pos.x, pv1->pos.x), pv2->pos.x) + reach;
+	const float minY = std::min(std::min(pv0->pos.y, pv1->pos.y), pv2->pos.y) - reach;
+	const float maxY = std::max(std::max(pv0->pos.y, pv1->pos.y), pv2->pos.y) + reach;
+
+	const ScreenRect bounds = {
+		std::max((int)std::ceil(minX - 0.5f), rect.xStart),
+		std::max((int)std::ceil(minY - 0.5f), rect.yStart),
+		std::min((int)std::floor(maxX - 0.5f) + 1, rect.xEnd), // the pixel AFTER the last pixel drawn
+		std::min((int)std::floor(maxY - 0.5f) + 1, rect.yEnd) // the scanline AFTER the last line drawn
+	};
+
+	RasterizeBlocks(edges, bounds, triangle, context);
+}
+
+template<class Effect>
+template<typename V>
+void Pipeline<Effect>::DrawTriangleFixedPoint(const Triangle<const V&>& triangle, const RasterContext& context, const ScreenRect& rect) {
+
+	// vertices too far outside the screen to snap
+	const float maxCoordinate = FixedEdgeEquation::MaxCoordinate;
+	for (const V* pv : { &triangle.v0, &triangle.v1, &triangle.v2 }) {
+		if (!(std::abs(pv->pos.x) < maxCoordinate && std::abs(pv->pos.y) < maxCoordinate)) {
+			DrawTriangleHalfSpace(triangle, context, rect);
+			return;
+		}
+	}
+
+	// snap to 28.4 fixed point, everything deciding coverage from here on is integer
+	int x[3] = { FixedEdgeEquation::Snap(triangle.v0.pos.x), FixedEdgeEquation::Snap(triangle.v1.pos.x), FixedEdgeEquation::Snap(triangle.v2.pos.x) };
+	int y[3] = { FixedEdgeEquation::Snap(triangle.v0.pos.y), FixedEdgeEquation::Snap(triangle.v1.pos.y), FixedEdgeEquation::Snap(triangle.v2.pos.y) };
+
+	// twice the signed area of the snapped triangle, skip degenerate triangles
+	const long long area = (long long)(x[2] - x[0]) * (y[1] - y[0]) - (long long)(y[2] - y[0]) * (x[1] - x[0]);
+	if (area == 0) {
+		return;
+	}
+
+	// clipping can flip the winding, order vertices so the interior is on the positive side of every edge
+	if (area < 0) {
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+	}
+
+	const FixedEdgeEquation edges[3] = {
+		FixedEdgeEquation(x[0], y[0], x[1], y[1]),
+		FixedEdgeEquation(x[1], y[1], x[2], y[2]),
+		FixedEdgeEquation(x[2], y[2], x[0], y[0])
+	};
+
+	// bounding box of pixel centers (of pixels with samples inside when multisampled), clamped to the target rect
+	const int reach = mSamples > 1 ? SampleReach : 0;
+	const ScreenRect bounds = {
+		std::max(FixedEdgeEquation::FirstPixel(std::min(std::min(x[0], x[1]), x[2]) - reach), rect.xStart),
+		std::max(FixedEdgeEquation::FirstPixel(std::min(std::min(y[0], y[1]), y[2]) - reach), rect.yStart),
+		std::min(FixedEdgeEquation::LastPixel(std::max(std::max(x[0], x[1]), x[2]) + reach) + 1, rect.xEnd),
+		std::min(FixedEdgeEquation::LastPixel(std::max(std::max(y[0], y[1]), y[2]) + reach) + 1, rect.yEnd)
+	};
+
+	RasterizeBlocks(edges, bounds, triangle, context);
+}
+
+template<class Effect>
+template<typename Edge, typename V>
+void Pipeline<Effect>::RasterizeBlocks(const Edge (&edges)[3], const ScreenRect& bounds, const Triangle<const V&>& triangle, const RasterContext& context) {
+
+	const int xStart = bounds.xStart;
+	const int yStart = bounds.yStart;
+	const int xEnd = bounds.xEnd;
+	const int yEnd = bounds.yEnd;
+	if (xStart >= xEnd || yStart >= yEnd) {
+		return;
+	}
+
+	// skip triangles hidden behind everything already drawn
+	const V* pv0 = &triangle.v0;
+	const float zMin = std::min(std::min(triangle.v0.pos.z, triangle.v1.pos.z), triangle.v2.pos.z);
+	if (pZb->IsOccluded(xStart, yStart, xEnd, yEnd, GetCullDepth(zMin, context))) {
+		return;
+	}
+
+	// attribute plane equations: change in interpolant for every 1 change in x and in y
+	V ditdx;
+	V ditdy;
+	if (!SetupGradients(triangle, ditdx, ditdy)) {
+		return;
+	}
+
+	// edge and depth offsets from a pixel center to its samples
+	const int samples = mSamples;
+	typename Edge::Value sampleEdge[3][MaxSamples];
+	DirectX::XMFLOAT4 samplePos[MaxSamples];
+	float sampleZMin = 0.0f;
+	for (int s = 0; s < samples; s++) {
+		const int dx = samples > 1 ? SampleOffsetX[s] : 0;
+		const int dy = samples > 1 ? SampleOffsetY[s] : 0;
+		for (int i = 0; i < 3; i++) {
+			sampleEdge[i][s] = edges[i].SampleOffset(dx, dy);
+		}
+		samplePos[s].z = (ditdx.pos.z * float(dx) + ditdy.pos.z * float(dy)) * (1.0f / 16.0f);
+		samplePos[s].w = (ditdx.pos.w * float(dx) + ditdy.pos.w * float(dy)) * (1.0f / 16.0f);
+		sampleZMin = std::min(sampleZMin, samplePos[s].z);
+	}
+
+	// offsets from the first pixel of a block to its nearest depth
+	const float zMinOffset = std::min(ditdx.pos.z, 0.0f) * float(BlockSize - 1) + std::min(ditdy.pos.z, 0.0f) * float(BlockSize - 1) + sampleZMin;
+
+	// block corners widened by the samples
+	typename Edge::Value minOffset[3];
+	typename Edge::Value maxOffset[3];
+	for (int i = 0; i < 3; i++) {
+		minOffset[i] = edges[i].MinBlockOffset(BlockSize) + *std::min_element(sampleEdge[i], sampleEdge[i] + samples);
+		maxOffset[i] = edges[i].MaxBlockOffset(BlockSize) + *std::max_element(sampleEdge[i], sampleEdge[i] + samples);
+	}
+
+	// walk the bounding box in screen aligned blocks
+	for (int by = yStart & ~(BlockSize - 1); by < yEnd; by += BlockSize) {
+		const int yBlockStart = std::max(by, yStart);
+		const int yBlockEnd = std::min(by + BlockSize, yEnd);
+
+		for (int bx = xStart & ~(BlockSize - 1); bx < xEnd; bx += BlockSize) {
+			const int xBlockStart = std::max(bx, xStart);
+			const int xBlockEnd = std::min(bx + BlockSize, xEnd);
+
+			// edge values at the first pixel center of the block
+			typename Edge::Value e[3];
+			bool reject = false;
+			bool accept = true;
+			for (int i = 0; i < 3; i++) {
+				e[i] = edges[i].EvaluatePixel(bx, by);
+				// even the best corner is outside -> whole block is outside
+				if (!edges[i].Test(e[i] + maxOffset[i])) {
+					reject = true;
+					break;
+				}
+				// worst corner is outside -> block is only partially covered
+				if (!edges[i].Test(e[i] + minOffset[i])) {
+					accept = false;
+				}
+			}
+			if (reject) {
+				continue;
+			}
+
+			// coarse depth rejection: nearest depth of the triangle plane inside the block
+			// (never nearer than the nearest vertex) against the farthest depth of the tile
+			const float cx = float(bx) + 0.5f;
+			const float cy = float(by) + 0.5f;
+			const float zBlock = pv0->pos.z + ditdx.pos.z * (cx - pv0->pos.x) + ditdy.pos.z * (cy - pv0->pos.y);
+			if (GetCullDepth(std::max(zBlock + zMinOffset, zMin), context) >= pZb->GetTileMax(bx / BlockSize, by / BlockSize)) {
+				continue;
+			}
+
+			// pixels are shaded in 2x2 quads aligned to even coordinates, the quad origin can lie
+			// one pixel before the bounding box but never outside the block (or the target rect)
+			const int qxStart = xBlockStart & ~1;
+			const int qyStart = yBlockStart & ~1;
+			const int count = xBlockEnd - qxStart;
+			const int lead = xBlockStart - qxStart;
+
+			// interpolant at the first quad of the block, evaluated directly from the plane equations
+			const float sx = float(qxStart) + 0.5f;
+			const float sy = float(qyStart) + 0.5f;
+			V itQuad = *pv0 + ditdx * (sx - pv0->pos.x) + ditdy * (sy - pv0->pos.y);
+			const V ditQuad = ditdy * 2.0f;
+
+			for (int y = qyStart; y < yBlockEnd; y += 2, itQuad += ditQuad) {
+				// depth test both rows of the quads first, rows outside the bounding box stay uncovered
+				unsigned int masks[2][MaxSamples] = {};
+				unsigned int passed = 0u;
+				for (int row = 0; row < 2; row++) {
+					const int py = y + row;
+					if (py < yBlockStart || py >= yBlockEnd) {
+						continue;
+					}
+
+					unsigned int coverage[MaxSamples];
+					if (accept) {
+						// fully covered block, no edge tests needed
+						std::fill_n(coverage, samples, ~0u << lead);
+					}
+					else {
+						// partially covered block, test every sample against all three edges
+						const typename Edge::Value e0 = edges[0].EvaluatePixel(xBlockStart, py);
+						const typename Edge::Value e1 = edges[1].EvaluatePixel(xBlockStart, py);
+						const typename Edge::Value e2 = edges[2].EvaluatePixel(xBlockStart, py);
+						unsigned int covered = 0u;
+						for (int s = 0; s < samples; s++) {
+							typename Edge::Value s0 = e0 + sampleEdge[0][s];
+							typename Edge::Value s1 = e1 + sampleEdge[1][s];
+							typename Edge::Value s2 = e2 + sampleEdge[2][s];
+							coverage[s] = 0u;
+							for (int x = xBlockStart; x < xBlockEnd; x++) {
+								if (edges[0].Test(s0) && edges[1].Test(s1) && edges[2].Test(s2)) {
+									coverage[s] |= 1u << (x - qxStart);
+								}
+								s0 += edges[0].A;
+								s1 += edges[1].A;
+								s2 += edges[2].A;
+							}
+							covered |= coverage[s];
+						}
+						if (covered == 0u) {
+							continue;
+						}
+					}
+
+					const DirectX::XMFLOAT4 pos = (row ? itQuad + ditdy : itQuad).pos;
+					float w[MaxSpanWidth];
+					for (int s = 0; s < samples; s++) {
+						if (coverage[s] == 0u) {
+							continue;
+						}
+						DirectX::XMFLOAT4 sample = pos;
+						sample.z += samplePos[s].z;
+						sample.w += samplePos[s].w;
+						masks[row][s] = DepthTestSpan(qxStart, py, count, sample, ditdx.pos, coverage[s], s, context, w);
+						passed |= masks[row][s];
+					}
+				}
+
+				if (context.ps != nullptr && passed != 0u) {
+					ShadeQuads(qxStart, y, count, masks, itQuad, ditdx, ditdy, *context.ps);
+				}
+			}
+		}
+	}
+}
+
+template<class Effect>
+unsigned int Pipeline<Effect>::DepthTestSpan(int x, int y, int count, const DirectX::XMFLOAT4& pos, const DirectX::XMFLOAT4& dpos, unsigned int coverage, int sample, const RasterContext& context, float* w) {
+	// do z rejection / update of z buffer for the whole span,
+	// recovering w from interpolated 1/w for the lanes that passed
+	const DepthSpanKernel kernel = context.pass == RasterPass::Shade ? mDepthEqualSpan : mDepthSpan;
+	const unsigned int mask = kernel(pZb->GetSpan(x, y, count, sample), count, pos.z, dpos.z, pos.w, dpos.w, coverage, w);
+	if (mask == 0u) {
+		return 0u;
+	}
+
+	// the equal test leaves the depths alone
+	if (context.pass == RasterPass::Shade) {
+		return mask;
+	}
+
+	// depths were written behind the z-buffer's back, refresh the coarse level of the touched tiles
+	for (int tx = x / ZBuffer::TileSize, txEnd = (x + count - 1) / ZBuffer::TileSize; tx <= txEnd; tx++) {
+		pZb->MarkTileDirty(tx, y / ZBuffer::TileSize);
+	}
+
+	// visibility buffer: remember who won the pixel, shading happens once in EndFrame
+	if (context.ps == nullptr && context.pass == RasterPass::Color) {
+		unsigned int* ids = &mVisibility[y * mWidth + x];
+		for (int i = 0; i < count; i++) {
+			if (mask & (1u << i)) {
+				ids[i] = context.triangleId;
+			}
+		}
+	}
+
+	return mask;
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawSpan(int x, int y, int count, const VSOutput& it, const VSOutput& ditdx, const VSOutput& ditdy, unsigned int coverage, const RasterContext& context) {
+	// skip shading step for lanes that were z rejected (early z)
+	float w[MaxSpanWidth];
+	unsigned int mask = DepthTestSpan(x, y, count, it.pos, ditdx.pos, coverage, 0, context, w);
+	if (mask == 0u || context.ps == nullptr) {
+		return;
+	}
+
+	PixelShader& ps = *context.ps;
+
+	for (int i = 0; mask != 0u; i++, mask >>= 1) {
+		if (mask & 1u) {
+			// recover interpolated attributes
+			auto attr = (it + ditdx * float(i)) * w[i];
+
+			// exact derivatives of the perspective correct attributes: d(it / iw) = (dit - attr * diw) / iw
+			const VSOutput ddx = (ditdx - attr * ditdx.pos.w) * w[i];
+			const VSOutput ddy = (ditdy - attr * ditdy.pos.w) * w[i];
+
+			// invoke pixel shader with interpolated vertex attributes
+			// and use result to set the pixel color on the screen
+			PutPixel(x + i, y, ps(attr, ddx, ddy).dword);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::ShadeQuads(int x, int y, int count, const unsigned int (&masks)[2][MaxSamples], const VSOutput& it, const VSOutput& ditdx, const VSOutput& ditdy, PixelShader& ps) {
+
+	for (int qx = 0; qx < count; qx += 2) {
+		// bit s of a lane is set if its sample s passed
+		unsigned int laneSamples[4] = { 0u, 0u, 0u, 0u };
+		for (int s = 0; s < mSamples; s++) {
+			for (int i = 0; i < 4; i++) {
+				laneSamples[i] |= ((masks[i >> 1][s] >> (qx + (i & 1))) & 1u) << s;
+			}
+		}
+		if ((laneSamples[0] | laneSamples[1] | laneSamples[2] | laneSamples[3]) != 0u) {
+			ShadeQuad(x + qx, y, laneSamples, it + ditdx * float(qx), ditdx, ditdy, ps);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::ShadeQuad(int x, int y, const unsigned int (&laneSamples)[4], const VSOutput& it, const VSOutput& ditdx, const VSOutput& ditdy, PixelShader& ps) {
+
+	// recover interpolated attributes of all four lanes, helper lanes included
+	// (they lie outside the triangle or failed the depth test, but their values are still on the plane)
+	VSOutput attr[4];
+	attr[0] = it;
+	attr[1] = it + ditdx;
+	attr[2] = it + ditdy;
+	attr[3] = attr[1] + ditdy;
+	for (int i = 0; i < 4; i++) {
+		attr[i] *= 1.0f / attr[i].pos.w;
+	}
+
+	// coarse derivatives, one pair for the whole quad
+	const VSOutput ddx = attr[1] - attr[0];
+	const VSOutput ddy = attr[2] - attr[0];
+
+	unsigned int laneMask = 0u;
+	for (int i = 0; i < 4; i++) {
+		laneMask |= laneSamples[i] != 0u ? 1u << i : 0u;
+	}
+
+	// the whole quad in one call
+	unsigned int colors[4];
+	ps(attr, laneMask, ddx, ddy, colors);
+
+	for (int i = 0; i < 4; i++) {
+		if (laneMask & (1u << i)) {
+			PutPixel(x + (i & 1), y + (i >> 1), colors[i], laneSamples[i]);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::PutPixel(int x, int y, unsigned int color, unsigned int sampleMask) {
+	if (mSamples > 1) {
+		const int tile = (y / TileSize) * mTilesX + x / TileSize;
+		if (mColorTileCleared[tile]) {
+			FillSamples(tile);
+		}
+		unsigned int* samples = &mSampleColors[(tile * (TileSize * TileSize) + (y % TileSize) * TileSize + x % TileSize) * MaxSamples];
+		for (int s = 0; s < MaxSamples; s++) {
+			if (sampleMask & (1u << s)) {
+				samples[s] = color;
+			}
+		}
+	}
+	else {
+		WritePixel(x, y, color);
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::LoadSamples(size_t tileIndex) {
+	const int tx = int(tileIndex) % mTilesX;
+	const int ty = int(tileIndex) / mTilesX;
+	const int xStart = tx * TileSize;
+	const int yStart = ty * TileSize;
+	const int xEnd = std::min(xStart + TileSize, mWidth);
+	const int yEnd = std::min(yStart + TileSize, mHeight);
+
+	const unsigned int* target = mSysBuff.GetMipData(0);
+	unsigned int* tile = &mSampleColors[tileIndex * (TileSize * TileSize * MaxSamples)];
+	for (int y = yStart; y < yEnd; y++) {
+		for (int x = xStart; x < xEnd; x++) {
+			unsigned int* samples = tile + ((y - yStart) * TileSize + x - xStart) * MaxSamples;
+			std::fill_n(samples, MaxSamples, target[mSysBuff.GetTexelIndex(0, x, y)]);
+		}
+	}
+	mColorTileCleared[tileIndex] = 0u;
+}
+
+template<class Effect>
+void Pipeline<Effect>::FillSamples(size_t tileIndex) {
+	unsigned int* tile = &mSampleColors[tileIndex * (TileSize * TileSize * MaxSamples)];
+	std::fill(tile, tile + TileSize * TileSize * MaxSamples, mClearColor);
+	mColorTileCleared[tileIndex] = 0u;
+}
+
+template<class Effect>
+void Pipeline<Effect>::ResolveSamples(size_t tileIndex) {
+	static_assert(MaxSamples == 4, "the resolve divides by shifting");
+
+	const int tx = int(tileIndex) % mTilesX;
+	const int ty = int(tileIndex) / mTilesX;
+	const int xStart = tx * TileSize;
+	const int yStart = ty * TileSize;
+	const int xEnd = std::min(xStart + TileSize, mWidth);
+	const int yEnd = std::min(yStart + TileSize, mHeight);
+
+	// nothing was drawn into a tile still flagged by a fast clear, its pixels are the clear color
+	// (in Tiled layout the flag stays set and ResolveTile writes them)
+	if (mColorTileCleared[tileIndex]) {
+		if (mTargetLayout == TargetLayout::Linear) {
+			for (int y = yStart; y < yEnd; y++) {
+				for (int x = xStart; x < xEnd; x++) {
+					WritePixel(x, y, mClearColor);
+				}
+			}
+		}
+		return;
+	}
+
+	const unsigned int* tile = &mSampleColors[tileIndex * (TileSize * TileSize * MaxSamples)];
+	for (int y = yStart; y < yEnd; y++) {
+		for (int x = xStart; x < xEnd; x++) {
+			const unsigned int* samples = tile + ((y - yStart) * TileSize + x - xStart) * MaxSamples;
+
+			// rounded average of every channel, two channels at a time with room for the carries
+			unsigned int evenChannels = 0x00020002u;
+			unsigned int oddChannels = 0x00020002u;
+			for (int s = 0; s < MaxSamples; s++) {
+				evenChannels += samples[s] & 0x00FF00FFu;
+				oddChannels += (samples[s] >> 8u) & 0x00FF00FFu;
+			}
+			WritePixel(x, y, ((evenChannels >> 2u) & 0x00FF00FFu) | (((oddChannels >> 2u) & 0x00FF00FFu) << 8u));
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::WritePixel(int x, int y, unsigned int color) {
+	if (mTargetLayout == TargetLayout::Tiled) {
+		const int tile = (y / TileSize) * mTilesX + x / TileSize;
+		if (mColorTileCleared[tile]) {
+			FillTile(tile);
+		}
+		mColorTiles[tile * (TileSize * TileSize) + (y % TileSize) * TileSize + x % TileSize] = color;
+	}
+	else {
+		mSysBuff.PutPixel(x, y, ColorIntegers(color));
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::LoadTile(size_t tileIndex) {
+	const int tx = int(tileIndex) % mTilesX;
+	const int ty = int(tileIndex) / mTilesX;
+	const int xStart = tx * TileSize;
+	const int yStart = ty * TileSize;
+	const int width = std::min(TileSize, mWidth - xStart);
+	const int height = std::min(TileSize, mHeight - yStart);
+
+	const unsigned int* target = mSysBuff.GetMipData(0);
+	unsigned int* tile = &mColorTiles[tileIndex * (TileSize * TileSize)];
+	for (int y = 0; y < height; y++) {
+		std::memcpy(tile + y * TileSize, target + mSysBuff.GetTexelIndex(0, xStart, yStart + y), width * sizeof(unsigned int));
+	}
+	mColorTileCleared[tileIndex] = 0u;
+}
+
+template<class Effect>
+void Pipeline<Effect>::FillTile(size_t tileIndex) {
+	unsigned int* tile = &mColorTiles[tileIndex * (TileSize * TileSize)];
+	std::fill(tile, tile + TileSize * TileSize, mClearColor);
+	mColorTileCleared[tileIndex] = 0u;
+}
+
+template<class Effect>
+void Pipeline<Effect>::ResolveTile(size_t tileIndex) {
+	const int tx = int(tileIndex) % mTilesX;
+	const int ty = int(tileIndex) / mTilesX;
+	const int xStart = tx * TileSize;
+	const int yStart = ty * TileSize;
+	const int width = std::min(TileSize, mWidth - xStart);
+	const int height = std::min(TileSize, mHeight - yStart);
+
+	unsigned int* target = mSysBuff.GetMipData(0);
+	const unsigned int* tile = &mColorTiles[tileIndex * (TileSize * TileSize)];
+	for (int y = 0; y < height; y++) {
+		unsigned int* row = target + mSysBuff.GetTexelIndex(0, xStart, yStart + y);
+		// nothing was drawn into a tile still flagged by a fast clear, it never has to be filled
+		if (mColorTileCleared[tileIndex]) {
+			std::fill(row, row + width, mClearColor);
+		}
+		else {
+			std::memcpy(row, tile + y * TileSize, width * sizeof(unsigned int));
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::ForEachTile(const std::function<void(size_t)>& job) {
+	if (mThreadPool) {
+		mThreadPool->ParallelFor(mBins.size(), job);
+	}
+	else {
+		for (size_t tileIndex = 0; tileIndex < mBins.size(); tileIndex++) {
+			job(tileIndex);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::BinTriangle(const TriangleRef& triangle) {
+
+	// bounding box of pixel centers, same rounding as the rasterizer,
+	// padded by the distance fixed-point snapping can move a vertex (and by the sample reach when multisampled)
+	const float snap = (0.5f + float(mSamples > 1 ? SampleReach : 0)) / float(FixedEdgeEquation::SubpixelScale);
+	const float minX = std::min(std::min(triangle.v0.pos.x, triangle.v1.pos.x), triangle.v2.pos.x) - snap;
+	const float maxX = std::max(std::max(triangle.v0.pos.x, triangle.v1.pos.x), triangle.v2.pos.x) + snap;
+	const float minY = std::min(std::min(triangle.v0.pos.y, triangle.v1.pos.y), triangle.v2.pos.y) - snap;
+	const float maxY = std::max(std::max(triangle.v0.pos.y, triangle.v1.pos.y), triangle.v2.pos.y) + snap;
+
+	const int xStart = std::max((int)std::ceil(minX - 0.5f), 0);
+	const int xEnd = std::min((int)std::floor(maxX - 0.5f) + 1, mWidth);
+	const int yStart = std::max((int)std::ceil(minY - 0.5f), 0);
+	const int yEnd = std::min((int)std::floor(maxY - 0.5f) + 1, mHeight);
+	if (xStart >= xEnd || yStart >= yEnd) {
+		return;
+	}
+
+	const size_t triangleIndex = RecordTriangle(triangle);
+
+	for (int ty = yStart / TileSize, tyEnd = (yEnd - 1) / TileSize; ty <= tyEnd; ty++) {
+		for (int tx = xStart / TileSize, txEnd = (xEnd - 1) / TileSize; tx <= txEnd; tx++) {
+			mBins[ty * mTilesX + tx].PushBack(mFrameArena, triangleIndex);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::RasterizeTile(size_t tileIndex) {
+
+	const int tx = int(tileIndex) % mTilesX;
+	const int ty = int(tileIndex) / mTilesX;
+	const ScreenRect rect = {
+		tx * TileSize,
+		ty * TileSize,
+		std::min((tx + 1) * TileSize, mWidth),
+		std::min((ty + 1) * TileSize, mHeight)
+	};
+
+	if (mShadingMode == ShadingMode::DepthPrepass) {
+		// the depth of the tile is complete before anything in it is shaded
+		for (size_t triangleIndex : mBins[tileIndex]) {
+			DrawFrameTriangle(triangleIndex, RasterPass::DepthOnly, rect);
+		}
+		for (size_t triangleIndex : mBins[tileIndex]) {
+			DrawFrameTriangle(triangleIndex, RasterPass::Shade, rect);
+		}
+	}
+	else {
+		for (size_t triangleIndex : mBins[tileIndex]) {
+			DrawFrameTriangle(triangleIndex, RasterPass::Color, rect);
+		}
+	}
+}
+
+template<class Effect>
+void Pipeline<Effect>::DrawFrameTriangle(size_t triangleIndex, RasterPass pass, const ScreenRect& rect) {
+
+	FrameTriangle& recorded = mFrameTriangles[triangleIndex];
+
+	// the half-space rasterizers interpolate nothing but the positions for depth
+	// (the scanline walk keeps its planes, its pixels only ever see the depth kernel anyway)
+	if (pass == RasterPass::DepthOnly && mRasterMode != RasterMode::Scanline) {
+		const DepthVertex v0(recorded.triangle.v0.pos);
+		const DepthVertex v1(recorded.triangle.v1.pos);
+		const DepthVertex v2(recorded.triangle.v2.pos);
+		const Triangle<const DepthVertex&> triangle = { v0, v1, v2 };
+		const RasterContext context = { nullptr, (unsigned int)triangleIndex, pass };
+		if (mRasterMode == RasterMode::FixedPoint) {
+			DrawTriangleFixedPoint(triangle, context, rect);
+		}
+		else {
+			DrawTriangleHalfSpace(triangle, context, rect);
+		}
+		return;
+	}
+
+	const bool shaded = pass != RasterPass::DepthOnly && mShadingMode != ShadingMode::VisibilityBuffer;
+	const RasterContext context = {
+		shaded ? &mDrawStates[recorded.drawIndex] : nullptr,
+		(unsigned int)triangleIndex,
+		pass
+	};
+	const TriangleRef triangle = { recorded.triangle.v0, recorded.triangle.v1, recorded.triangle.v2 };
+	if (mRasterMode == RasterMode::FixedPoint) {
+		DrawTriangleFixedPoint(triangle, context, rect);
+	}
+	else if (mRasterMode == RasterMode::HalfSpace) {
+		DrawTriangleHalfSpace(triangle, context, rect);
+	}
+	else {
+		DrawTriangle(triangle, context);
+	}
+}
+
+template<class Effect>
+bool Pipeline<Effect>::IsOccluded(const TriangleRef& triangle, const ScreenRect& rect, const RasterContext& context) {
+
+	// bounding box of pixel centers, clamped to the target rect
+	const float minX = std::min(std::min(triangle.v0.pos.x, triangle.v1.pos.x), triangle.v2.pos.x);
+	const float maxX = std::max(std::max(triangle.v0.pos.x, triangle.v1.pos.x), triangle.v2.pos.x);
+	const float minY = std::min(std::min(triangle.v0.pos.y, triangle.v1.pos.y), triangle.v2.pos.y);
+	const float maxY = std::max(std::max(triangle.v0.pos.y, triangle.v1.pos.y), triangle.v2.pos.y);
+
+	const int xStart = std::max((int)std::ceil(minX - 0.5f), rect.xStart);
+	const int xEnd = std::min((int)std::floor(maxX - 0.5f) + 1, rect.xEnd);
+	const int yStart = std::max((int)std::ceil(minY - 0.5f), rect.yStart);
+	const int yEnd = std::min((int)std::floor(maxY - 0.5f) + 1, rect.yEnd);
+	if (xStart >= xEnd || yStart >= yEnd) {
+		return true;
+	}
+
+	const float zMin = std::min(std::min(triangle.v0.pos.z, triangle.v1.pos.z), triangle.v2.pos.z);
+	return pZb->IsOccluded(xStart, yStart, xEnd, yEnd, GetCullDepth(zMin, context));
+}
+
+template<class Effect>
+float Pipeline<Effect>::GetCullDepth(float zMin, const RasterContext& context) const {
+	if (context.pass != RasterPass::Shade) {
+		return zMin;
+	}
+	return zMin - std::abs(zMin) * CullMargin - pZb->GetDepthStep();
+}
+
+template<class Effect>
+bool Pipeline<Effect>::IsBinning() const {
+	return mThreadPool && mRasterMode != RasterMode::Scanline;
+}
+
+template<class Effect>
+bool Pipeline<Effect>::IsDeferred() const {
+	return IsBinning() || mShadingMode != ShadingMode::Forward;
+}
+
+template<class Effect>
+template<typename V>
+bool Pipeline<Effect>::SetupGradients(const Triangle<const V&>& triangle, V& ditdx, V& ditdy) {
+
+	const float dx1 = triangle.v1.pos.x - triangle.v0.pos.x;
+	const float dy1 = triangle.v1.pos.y - triangle.v0.pos.y;
+	const float dx2 = triangle.v2.pos.x - triangle.v0.pos.x;
+	const float dy2 = triangle.v2.pos.y - triangle.v0.pos.y;
+	const float det = dx1 * dy2 - dx2 * dy1;
+	if (det == 0.0f) {
+		return false;
+	}
+
+	// solve it(v) = it0 + ditdx * (v.x - v0.x) + ditdy * (v.y - v0.y) for v1 and v2
+	const V d10 = triangle.v1 - triangle.v0;
+	const V d20 = triangle.v2 - triangle.v0;
+	ditdx = (d10 * dy2 - d20 * dy1) / det;
+	ditdy = (d20 * dx1 - d10 * dx2) / det;
+
+	return true;
+}
+
+template<class Effect>
+unsigned int Pipeline<Effect>::RecordTriangle(const TriangleRef& triangle) {
+
+	const unsigned int triangleId = (unsigned int)mFrameTriangles.Size();
+	mFrameTriangles.PushBack(mFrameArena, { { triangle.v0, triangle.v1, triangle.v2 }, mDrawStates.Size() - 1 });
+
+	// the visibility buffer resolve evaluates attributes straight from the plane equations
+	if (mShadingMode == ShadingMode::VisibilityBuffer) {
+		// a zero area triangle covers no pixel, flat gradients keep its record defined all the same
+		FrameTriangle& recorded = mFrameTriangles.Back();
+		if (!SetupGradients(triangle, recorded.ditdx, recorded.ditdy)) {
+			recorded.ditdx = VSOutput();
+			recorded.ditdy = VSOutput();
+		}
+	}
+
+	return triangleId;
+}
+
+template<class Effect>
+void Pipeline<Effect>::ResolveVisibility(int yStart, int yEnd) {
+
+	// shade 2x2 quads, once for every triangle visible in the quad,
+	// lanes owned by other triangles (or nothing) act as helper lanes
+	for (int y = yStart; y < yEnd; y += 2) {
+		for (int x = 0; x < mWidth; x += 2) {
+			unsigned int ids[4];
+			for (int i = 0; i < 4; i++) {
+				const int px = x + (i & 1);
+				const int py = y + (i >> 1);
+				ids[i] = (px < mWidth && py < yEnd) ? mVisibility[py * mWidth + px] : NoTriangle;
+			}
+
+			for (int i = 0; i < 4; i++) {
+				const unsigned int triangleId = ids[i];
+				if (triangleId == NoTriangle) {
+					continue;
+				}
+
+				unsigned int laneMask = 0u;
+				for (int j = i; j < 4; j++) {
+					if (ids[j] == triangleId) {
+						laneMask |= 1u << j;
+						ids[j] = NoTriangle;
+					}
+				}
+
+				FrameTriangle& visible = mFrameTriangles[triangleId];
+				const VSOutput& it0 = visible.triangle.v0;
+
+				// interpolant at the quad origin from the plane equations
+				const VSOutput it = it0 + visible.ditdx * (float(x) + 0.5f - it0.pos.x) + visible.ditdy * (float(y) + 0.5f - it0.pos.y);
+
+				// invoke pixel shader of the draw the triangle came from, the visibility buffer is single sampled
+				const unsigned int laneSamples[4] = { laneMask & 1u, (laneMask >> 1) & 1u, (laneMask >> 2) & 1u, (laneMask >> 3) & 1u };
+				ShadeQuad(x, y, laneSamples, it, visible.ditdx, visible.ditdy, mDrawStates[visible.drawIndex]);
+			}
+		}
+	}
+}
\ No newline at end of file
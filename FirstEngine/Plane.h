@@ -55,7 +55,9 @@ public:
 			}
 		}
 
-		return{ std::move(vertices),std::move(indices) };
+		IndexedTriangleList itlist{ std::move(vertices),std::move(indices) };
+		itlist.BuildStreams();
+		return itlist;
 	}
 	
 	static IndexedTriangleList GetSkinned(int divisions_x = 7, int divisions_y = 7, float width = 1.0f, float height = 1.0f, float tScale = 1.0f) {
@@ -80,6 +82,7 @@ public:
 				}
 			}
 		}
+		itlist.VerticesChanged();
 
 		return itlist;
 	}
@@ -90,6 +93,7 @@ public:
 		for (auto& v : itlist.vertices) {
 			v.n = { 0.0f, 0.0f, -1.0f };
 		}
+		itlist.VerticesChanged();
 
 		return itlist;
 	}
@@ -100,6 +104,7 @@ public:
 		for (auto& v : itlist.vertices) {
 			v.n = { 0.0f, 0.0f, -1.0f };
 		}
+		itlist.VerticesChanged();
 
 		return itlist;
 	}
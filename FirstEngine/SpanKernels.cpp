@@ -0,0 +1,285 @@
+#include "SpanKernels.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// gcc and clang only emit avx2 instructions in functions that ask for them,
+// msvc accepts the intrinsics anywhere
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// 1 / x the way every level computes it: reciprocal estimate refined with one newton-raphson step, r' = r * (2 - x * r)
+// (the vector kernels do the same per lane, so w does not depend on the level or on where a lane falls in a span)
+static float Reciprocal(float x) {
+	const __m128 v = _mm_set_ss(x);
+	const __m128 r = _mm_rcp_ss(v);
+	return _mm_cvtss_f32(_mm_mul_ss(r, _mm_sub_ss(_mm_set_ss(2.0f), _mm_mul_ss(v, r))));
+}
+
+// lanes [first, count) of a span, evaluated from the start of the span like the vector lanes
+template<DepthTest Test>
+static unsigned int DepthLanesScalar(float* depth, int first, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	unsigned int mask = 0u;
+
+	for (int i = first; i < count; i++) {
+		const float zi = z + float(i) * dz;
+		if ((coverage & (1u << i)) && (Test == DepthTest::Less ? zi < depth[i] : zi == depth[i])) {
+			if (Test == DepthTest::Less) {
+				depth[i] = zi;
+			}
+			w[i] = Reciprocal(iw + float(i) * diw);
+			mask |= 1u << i;
+		}
+	}
+
+	return mask;
+}
+
+template<DepthTest Test>
+static unsigned int DepthSpanScalar(void* depthIn, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	return DepthLanesScalar<Test>(static_cast<float*>(depthIn), 0, count, z, dz, iw, diw, coverage, w);
+}
+
+// Stored is unsigned short for Unorm16 and unsigned int for Unorm24
+template<typename Stored, DepthFormat Format, DepthTest Test>
+static unsigned int DepthLanesUnormScalar(Stored* depth, int first, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	unsigned int mask = 0u;
+
+	for (int i = first; i < count; i++) {
+		const unsigned int zi = EncodeDepthUnorm(z + float(i) * dz, Format);
+		if ((coverage & (1u << i)) && (Test == DepthTest::Less ? zi < depth[i] : zi == depth[i])) {
+			if (Test == DepthTest::Less) {
+				depth[i] = Stored(zi);
+			}
+			w[i] = Reciprocal(iw + float(i) * diw);
+			mask |= 1u << i;
+		}
+	}
+
+	return mask;
+}
+
+template<typename Stored, DepthFormat Format, DepthTest Test>
+static unsigned int DepthSpanUnormScalar(void* depthIn, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	return DepthLanesUnormScalar<Stored, Format, Test>(static_cast<Stored*>(depthIn), 0, count, z, dz, iw, diw, coverage, w);
+}
+
+// same rounding as EncodeDepthUnorm
+static __m128i EncodeDepthUnormSSE2(__m128 z, DepthFormat format) {
+	const __m128 max = _mm_set1_ps(float(GetDepthUnormMax(format)));
+	const __m128 clamped = _mm_min_ps(_mm_max_ps(z, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(clamped, max));
+}
+
+template<DepthTest Test>
+static unsigned int DepthSpanSSE2(void* depthIn, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	float* depth = static_cast<float*>(depthIn);
+	const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	unsigned int mask = 0u;
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 base = _mm_set1_ps(float(i));
+		const __m128 zv = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(_mm_add_ps(base, lane), _mm_set1_ps(dz)));
+		const __m128 iwv = _mm_add_ps(_mm_set1_ps(iw), _mm_mul_ps(_mm_add_ps(base, lane), _mm_set1_ps(diw)));
+
+		// lane mask: covered and closer than the stored depth
+		const __m128i bits = _mm_and_si128(_mm_set1_epi32(int(coverage >> i)), laneBits);
+		const __m128 covered = _mm_castsi128_ps(_mm_cmpeq_epi32(bits, laneBits));
+		const __m128 stored = _mm_loadu_ps(depth + i);
+		const __m128 pass = _mm_and_ps(covered, Test == DepthTest::Less ? _mm_cmplt_ps(zv, stored) : _mm_cmpeq_ps(zv, stored));
+
+		// masked depth write
+		if (Test == DepthTest::Less) {
+			_mm_storeu_ps(depth + i, _mm_or_ps(_mm_and_ps(pass, zv), _mm_andnot_ps(pass, stored)));
+		}
+
+		// reciprocal estimate refined with one newton-raphson step: r' = r * (2 - x * r)
+		const __m128 r = _mm_rcp_ps(iwv);
+		_mm_storeu_ps(w + i, _mm_mul_ps(r, _mm_sub_ps(two, _mm_mul_ps(iwv, r))));
+
+		mask |= (unsigned int)_mm_movemask_ps(pass) << i;
+	}
+
+	// leftover pixels that do not fill a register
+	mask |= DepthLanesScalar<Test>(depth, i, count, z, dz, iw, diw, coverage, w);
+
+	return mask;
+}
+
+template<typename Stored, DepthFormat Format, DepthTest Test>
+static unsigned int DepthSpanUnormSSE2(void* depthIn, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	Stored* depth = static_cast<Stored*>(depthIn);
+	const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	unsigned int mask = 0u;
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 base = _mm_set1_ps(float(i));
+		const __m128i zv = EncodeDepthUnormSSE2(_mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(_mm_add_ps(base, lane), _mm_set1_ps(dz))), Format);
+		const __m128 iwv = _mm_add_ps(_mm_set1_ps(iw), _mm_mul_ps(_mm_add_ps(base, lane), _mm_set1_ps(diw)));
+
+		// stored depths widened to 32 bits, both formats fit the signed compare
+		const __m128i stored = sizeof(Stored) == 2 ?
+			_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth + i)), _mm_setzero_si128()) :
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i));
+
+		// lane mask: covered and closer than the stored depth
+		const __m128i bits = _mm_and_si128(_mm_set1_epi32(int(coverage >> i)), laneBits);
+		const __m128i pass = _mm_and_si128(_mm_cmpeq_epi32(bits, laneBits), Test == DepthTest::Less ? _mm_cmplt_epi32(zv, stored) : _mm_cmpeq_epi32(zv, stored));
+
+		// masked depth write
+		const __m128i merged = _mm_or_si128(_mm_and_si128(pass, zv), _mm_andnot_si128(pass, stored));
+		if (Test == DepthTest::Equal) {
+			// nothing to write
+		}
+		else if (sizeof(Stored) == 2) {
+			// sign extend the low halves so the saturating pack keeps values above 0x7FFF intact
+			const __m128i extended = _mm_srai_epi32(_mm_slli_epi32(merged, 16), 16);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(depth + i), _mm_packs_epi32(extended, extended));
+		}
+		else {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(depth + i), merged);
+		}
+
+		// reciprocal estimate refined with one newton-raphson step: r' = r * (2 - x * r)
+		const __m128 r = _mm_rcp_ps(iwv);
+		_mm_storeu_ps(w + i, _mm_mul_ps(r, _mm_sub_ps(two, _mm_mul_ps(iwv, r))));
+
+		mask |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(pass)) << i;
+	}
+
+	// leftover pixels that do not fill a register
+	mask |= DepthLanesUnormScalar<Stored, Format, Test>(depth, i, count, z, dz, iw, diw, coverage, w);
+
+	return mask;
+}
+
+template<DepthTest Test>
+TARGET_AVX2 static unsigned int DepthSpanAVX2(void* depthIn, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	const __m256 lane = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	const __m256i laneIndex = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	const __m256i laneBits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	float* depth = static_cast<float*>(depthIn);
+
+	// lanes past the end of the span are never loaded or stored
+	const __m256i inSpan = _mm256_cmpgt_epi32(_mm256_set1_epi32(count), laneIndex);
+
+	const __m256 zv = _mm256_add_ps(_mm256_set1_ps(z), _mm256_mul_ps(lane, _mm256_set1_ps(dz)));
+	const __m256 iwv = _mm256_add_ps(_mm256_set1_ps(iw), _mm256_mul_ps(lane, _mm256_set1_ps(diw)));
+
+	// lane mask: inside the span, covered and closer than the stored depth
+	const __m256i bits = _mm256_and_si256(_mm256_set1_epi32(int(coverage)), laneBits);
+	const __m256i covered = _mm256_and_si256(_mm256_cmpeq_epi32(bits, laneBits), inSpan);
+	const __m256 stored = _mm256_maskload_ps(depth, inSpan);
+	const __m256 pass = _mm256_and_ps(_mm256_castsi256_ps(covered), Test == DepthTest::Less ? _mm256_cmp_ps(zv, stored, _CMP_LT_OQ) : _mm256_cmp_ps(zv, stored, _CMP_EQ_OQ));
+
+	// masked depth write
+	if (Test == DepthTest::Less) {
+		_mm256_maskstore_ps(depth, _mm256_castps_si256(pass), zv);
+	}
+
+	// reciprocal estimate refined with one newton-raphson step: r' = r * (2 - x * r)
+	const __m256 r = _mm256_rcp_ps(iwv);
+	_mm256_storeu_ps(w, _mm256_mul_ps(r, _mm256_sub_ps(two, _mm256_mul_ps(iwv, r))));
+
+	return (unsigned int)_mm256_movemask_ps(pass);
+}
+
+template<typename Stored, DepthFormat Format, DepthTest Test>
+TARGET_AVX2 static unsigned int DepthSpanUnormAVX2(void* depthIn, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w) {
+	// 16 bit depths can not be loaded with a lane mask, partial spans take the sse2 path
+	if (count < MaxSpanWidth) {
+		return DepthSpanUnormSSE2<Stored, Format, Test>(depthIn, count, z, dz, iw, diw, coverage, w);
+	}
+
+	Stored* depth = static_cast<Stored*>(depthIn);
+	const __m256 lane = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	const __m256i laneBits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 max = _mm256_set1_ps(float(GetDepthUnormMax(Format)));
+
+	// same rounding as EncodeDepthUnorm
+	const __m256 zv = _mm256_add_ps(_mm256_set1_ps(z), _mm256_mul_ps(lane, _mm256_set1_ps(dz)));
+	const __m256 clamped = _mm256_min_ps(_mm256_max_ps(zv, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	const __m256i zq = _mm256_cvtps_epi32(_mm256_mul_ps(clamped, max));
+	const __m256 iwv = _mm256_add_ps(_mm256_set1_ps(iw), _mm256_mul_ps(lane, _mm256_set1_ps(diw)));
+
+	const __m256i stored = sizeof(Stored) == 2 ?
+		_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth))) :
+		_mm256_loadu_si256(reinterpret_cast<const __m256i*>(depth));
+
+	// lane mask: covered and closer than the stored depth
+	const __m256i bits = _mm256_and_si256(_mm256_set1_epi32(int(coverage)), laneBits);
+	const __m256i pass = _mm256_and_si256(_mm256_cmpeq_epi32(bits, laneBits), Test == DepthTest::Less ? _mm256_cmpgt_epi32(stored, zq) : _mm256_cmpeq_epi32(stored, zq));
+
+	// masked depth write, the whole span is rewritten
+	const __m256i merged = _mm256_blendv_epi8(stored, zq, pass);
+	if (Test == DepthTest::Equal) {
+		// nothing to write
+	}
+	else if (sizeof(Stored) == 2) {
+		// packus works within 128 bit halves, gather the two low quadwords
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(merged, merged), 0x08);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(depth), _mm256_castsi256_si128(packed));
+	}
+	else {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(depth), merged);
+	}
+
+	// reciprocal estimate refined with one newton-raphson step: r' = r * (2 - x * r)
+	const __m256 r = _mm256_rcp_ps(iwv);
+	_mm256_storeu_ps(w, _mm256_mul_ps(r, _mm256_sub_ps(two, _mm256_mul_ps(iwv, r))));
+
+	return (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(pass));
+}
+
+template<DepthTest Test>
+static DepthSpanKernel SelectDepthSpanKernel(SimdLevel level, DepthFormat format) {
+	switch (format) {
+	case DepthFormat::Unorm24:
+		switch (level) {
+		case SimdLevel::AVX2:
+			return DepthSpanUnormAVX2<unsigned int, DepthFormat::Unorm24, Test>;
+		case SimdLevel::SSE2:
+			return DepthSpanUnormSSE2<unsigned int, DepthFormat::Unorm24, Test>;
+		default:
+			return DepthSpanUnormScalar<unsigned int, DepthFormat::Unorm24, Test>;
+		}
+	case DepthFormat::Unorm16:
+		switch (level) {
+		case SimdLevel::AVX2:
+			return DepthSpanUnormAVX2<unsigned short, DepthFormat::Unorm16, Test>;
+		case SimdLevel::SSE2:
+			return DepthSpanUnormSSE2<unsigned short, DepthFormat::Unorm16, Test>;
+		default:
+			return DepthSpanUnormScalar<unsigned short, DepthFormat::Unorm16, Test>;
+		}
+	default:
+		switch (level) {
+		case SimdLevel::AVX2:
+			return DepthSpanAVX2<Test>;
+		case SimdLevel::SSE2:
+			return DepthSpanSSE2<Test>;
+		default:
+			return DepthSpanScalar<Test>;
+		}
+	}
+}
+
+DepthSpanKernel SelectDepthSpanKernel(SimdLevel level, DepthFormat format, DepthTest test) {
+	if (test == DepthTest::Equal) {
+		return SelectDepthSpanKernel<DepthTest::Equal>(level, format);
+	}
+	return SelectDepthSpanKernel<DepthTest::Less>(level, format);
+}
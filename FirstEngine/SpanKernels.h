@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "DepthFormat.h"
+
+// widest span a kernel handles in one call (one AVX2 register of floats)
+static constexpr int MaxSpanWidth = 8;
+
+// depth test and perspective recovery for a horizontal span of count <= MaxSpanWidth pixels
+//   depth    - z-buffer entry of the first pixel of the span, in the format the kernel was selected for
+//   z, dz    - interpolated depth of the first pixel and its change per pixel
+//   iw, diw  - interpolated 1/w of the first pixel and its change per pixel
+//   coverage - bit i set if pixel i is inside the primitive
+// pixels that are covered and closer than the z-buffer get their depth written
+// and w = 1 / (1/w) stored in w[i]; returns the bit mask of those pixels
+// unorm kernels convert z once per pixel and compare the integers
+// every level produces the same mask, depths and w for a span: lane i is evaluated as z + i * dz (and
+// iw + i * diw) from the start of the span, and w comes from the same refined reciprocal estimate
+using DepthSpanKernel = unsigned int (*)(void* depth, int count, float z, float dz, float iw, float diw, unsigned int coverage, float* w);
+
+// comparison of a depth span kernel
+//   Less  - pixels closer than the z-buffer pass and get their depth written
+//   Equal - pixels exactly at the z-buffer depth pass, nothing is written
+//           (for shading on top of a depth only pass that used the same interpolation)
+enum class DepthTest {
+	Less,
+	Equal
+};
+
+// kernel for the given level, depth format and test, levels without a vectorized kernel fall back to the next lower one
+DepthSpanKernel SelectDepthSpanKernel(SimdLevel level, DepthFormat format, DepthTest test = DepthTest::Less);
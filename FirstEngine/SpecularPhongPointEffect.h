@@ -2,12 +2,18 @@
 
 #include <algorithm>
 #include <cmath>
+#include <type_traits>
+#include <emmintrin.h>
 #include <DirectXMath.h>
 
 #include "Vertex.h"
 #include "Triangle.h"
+#include "Interpolant.h"
 #include "ColorIntegers.h"
 #include "TextureClass.h"
+#include "TextureSampler.h"
+#include "VertexStreams.h"
+#include "VertexKernels.h"
 
 class SpecularPhongPointEffect {
 public:
@@ -22,123 +28,38 @@ public:
 		static constexpr float specular_power		= 30.0f;
 		static constexpr float specular_intensity	= 0.6f;
 	};
-	
-	// vertex shader
-	// output interpolates position, normal, world position
-	class VSOutput {
-	public:
-		VSOutput() = default;
-		VSOutput(const DirectX::XMFLOAT4& pos) : pos(pos) {}
-		VSOutput(const DirectX::XMFLOAT4& pos, const VSOutput& src) : n(src.n), worldPos(src.worldPos), pos(pos) {}
-		VSOutput(const DirectX::XMFLOAT4& pos, const DirectX::XMFLOAT3& n, const DirectX::XMFLOAT3& worldPos) : n(n), pos(pos), worldPos(worldPos) {}
-
-		VSOutput& operator+=(const VSOutput& rhs) {
-
-			pos.x += rhs.pos.x;
-			pos.y += rhs.pos.y;
-			pos.z += rhs.pos.z;
-			pos.w += rhs.pos.w;
-
-			n.x += rhs.n.x;
-			n.y += rhs.n.y;
-			n.z += rhs.n.z;
-
-			worldPos.x += rhs.worldPos.x;
-			worldPos.y += rhs.worldPos.y;
-			worldPos.z += rhs.worldPos.z;
-
-			t.x += rhs.t.x;
-			t.y += rhs.t.y;
-
-			return *this;
-		}
-
-		VSOutput operator+(const VSOutput& rhs) const {
-			return VSOutput(*this) += rhs;
-		}
-
-		VSOutput& operator-=(const VSOutput& rhs) {
-			
-			pos.x -= rhs.pos.x;
-			pos.y -= rhs.pos.y;
-			pos.z -= rhs.pos.z;
-			pos.w -= rhs.pos.w;
-
-			n.x -= rhs.n.x;
-			n.y -= rhs.n.y;
-			n.z -= rhs.n.z;
-
-			worldPos.x -= rhs.worldPos.x;
-			worldPos.y -= rhs.worldPos.y;
-			worldPos.z -= rhs.worldPos.z;
-
-			t.x -= rhs.t.x;
-			t.y -= rhs.t.y;
-
-			return *this;
-		}
-
-		VSOutput operator-(const VSOutput& rhs) const {
-			return VSOutput(*this) -= rhs;
-		}
-
-		VSOutput& operator*=(float rhs) {
-			
-			pos.x *= rhs;
-			pos.y *= rhs;
-			pos.z *= rhs;
-			pos.w *= rhs;
-
-			n.x *= rhs;
-			n.y *= rhs;
-			n.z *= rhs;
-
-			worldPos.x *= rhs;
-			worldPos.y *= rhs;
-			worldPos.z *= rhs;
-
-			t.x *= rhs;
-			t.y *= rhs;
-
-			return *this;
-		}
-
-		VSOutput operator*(float rhs) const {
-			return VSOutput(*this) *= rhs;
-		}
-
-		VSOutput& operator/=(float rhs) {
-			
-			pos.x /= rhs;
-			pos.y /= rhs;
-			pos.z /= rhs;
-			pos.w /= rhs;
-
-			n.x /= rhs;
-			n.y /= rhs;
-			n.z /= rhs;
 
-			worldPos.x /= rhs;
-			worldPos.y /= rhs;
-			worldPos.z /= rhs;
-
-			t.x /= rhs;
-			t.y /= rhs;
-
-			return *this;
-		}
-
-		VSOutput operator/(float rhs) const {
-			return VSOutput(*this) /= rhs;
-		}
-
-	public:
-		DirectX::XMFLOAT4 pos;
-		DirectX::XMFLOAT3 n;
-		DirectX::XMFLOAT3 worldPos;
-		DirectX::XMFLOAT2 t;
+	// arithmetic of the pixel shader
+	//   Exact - full precision divides, square roots and std::pow; quads and single pixels round the same way
+	//           as the XMVector single pixel shader, for reference captures
+	//   Fast  - reciprocal and reciprocal square root estimates refined with one newton-raphson step
+	//           (relative error below 2^-21), single pixels go through the quad shader as well;
+	//           colors are expected to stay within about 1 (of 255) per channel of Exact, where a channel lands
+	//           next to a step of 1/255 - an estimate, not a bound: nearly zero length vectors and the
+	//           repeated squaring of the specular power can move a channel further
+	enum class ShadingPrecision {
+		Exact,
+		Fast
 	};
 
+	// the fast batched pixel shader raises to the specular power by repeated squaring
+	static_assert(SpecularParams::specular_power == float(int(SpecularParams::specular_power)), "specular power must be a whole number");
+	
+	// vertex shader
+	// output interpolates position, normal, world position, texture coordinates
+	static constexpr unsigned int Attributes = InterpolantAttribute::Normal | InterpolantAttribute::WorldPos | InterpolantAttribute::TexCoord;
+	using VSOutput = Interpolant<Attributes>;
+
+	// the batched vertex shader writes pos, n and worldPos through float pointers, point i at
+	// i * sizeof(VSOutput) / sizeof(float) floats: VSOutput must be plain floats without padding
+	// (the layered Interpolant is not standard layout, so the sizes stand in for offsetof)
+	static_assert(std::is_trivially_copyable<VSOutput>::value, "VSOutput must be trivially copyable");
+	static_assert(sizeof(VSOutput) % sizeof(float) == 0, "VSOutput must be a whole number of floats");
+	static_assert(sizeof(DirectX::XMFLOAT4) == 4 * sizeof(float) && sizeof(DirectX::XMFLOAT3) == 3 * sizeof(float)
+		&& sizeof(DirectX::XMFLOAT2) == 2 * sizeof(float), "pos, n, worldPos and t must be contiguous float runs");
+	static_assert(sizeof(VSOutput) == sizeof(DirectX::XMFLOAT4) + 2 * sizeof(DirectX::XMFLOAT3) + sizeof(DirectX::XMFLOAT2),
+		"VSOutput must hold pos, n, worldPos and t without padding");
+
 	class VertexShader {
 	public:
 		VertexShader() {
@@ -186,6 +107,30 @@ public:
 			return out;
 		}
 
+		// batched version for meshes with vertex streams, shades vertices [begin, end) into out[begin, end)
+		// with the matrices held in registers across the whole range, 4 or 8 vertices per step
+		void operator()(const VertexStreams& in, size_t begin, size_t end, VSOutput* out, SimdLevel level) const {
+			if (begin == end) {
+				return;
+			}
+
+			const TransformStreamKernel transform = SelectTransformStreamKernel(level);
+			const size_t count = end - begin;
+			const size_t stride = sizeof(VSOutput) / sizeof(float);
+			const float* x = &in.x[begin];
+			const float* y = &in.y[begin];
+			const float* z = &in.z[begin];
+			const float* w = &in.w[begin];
+
+			transform(x, y, z, w, count, worldViewProj, &out[begin].pos.x, stride, 4);
+			transform(&in.nx[begin], &in.ny[begin], &in.nz[begin], nullptr, count, worldView, &out[begin].n.x, stride, 3);
+			transform(x, y, z, w, count, worldView, &out[begin].worldPos.x, stride, 3);
+
+			for (size_t i = begin; i < end; i++) {
+				out[i].t = DirectX::XMFLOAT2(in.u[i], in.v[i]);
+			}
+		}
+
 	protected:
 		DirectX::XMFLOAT4X4 proj;
 		DirectX::XMFLOAT4X4 worldView;
@@ -199,7 +144,7 @@ public:
 	class GeometryShader {
 	public:
 
-		Triangle<VSOutput> operator()(VSOutput& in0, VSOutput& in1, VSOutput& in2, size_t triangle_index) {
+		Triangle<const VSOutput&> operator()(const VSOutput& in0, const VSOutput& in1, const VSOutput& in2, size_t triangle_index) {
 			return { in0, in1, in2 };
 		}
 	};
@@ -264,35 +209,242 @@ public:
 			light_pos = pos_in;
 		}
 
+		void SetPrecision(ShadingPrecision precision_in) {
+			precision = precision_in;
+		}
+
+		ShadingPrecision GetPrecision() const {
+			return precision;
+		}
+
+		void SetTextureFilter(TextureSampler::Filter filter) {
+			sampler.SetFilter(filter);
+		}
+
+		// samples the top mip level
 		ColorIntegers operator()(VSOutput& in) {
+			return ShadePixel(in, 0.0f);
+		}
 
-			ColorIntegers color = pTex->GetPixel(
-				unsigned int(in.t.x * tex_width + 0.5f) % tex_width,
-				unsigned int(in.t.y * tex_height + 0.5f) % tex_width
-			);
+		// ddx / ddy are the changes of the interpolated attributes to the neighbouring pixel in x and y,
+		// they select the mip level
+		ColorIntegers operator()(VSOutput& in, const VSOutput& ddx, const VSOutput& ddy) {
+			return ShadePixel(in, TextureLod(ddx, ddy));
+		}
 
-			auto material_color_t = DirectX::XMFLOAT3(
-				color.GetR() / 255.0f,
-				color.GetG() / 255.0f,
-				color.GetB() / 255.0f
-			);
+		// batched version for 2x2 quads, shades all four lanes at once in structure of arrays form
+		// (one sse register per attribute component), only lanes in laneMask are textured
+		// writes the packed colors (same layout as ColorIntegers::dword) of the lanes to colors
+		void operator()(const VSOutput (&in)[4], unsigned int laneMask, const VSOutput& ddx, const VSOutput& ddy, unsigned int (&colors)[4]) {
+			// one mip level selection for the whole quad
+			ShadeQuad(in, laneMask, TextureLod(ddx, ddy), colors);
+		}
 
-			return Shade(in, material_color_t);
+		// log2 of the texel footprint of a pixel with the given uv derivatives
+		float TextureLod(const VSOutput& ddx, const VSOutput& ddy) const {
+			const float dudx = ddx.t.x * tex_width;
+			const float dvdx = ddx.t.y * tex_height;
+			const float dudy = ddy.t.x * tex_width;
+			const float dvdy = ddy.t.y * tex_height;
+			const float footprint = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+			return 0.5f * std::log2(std::max(footprint, 1e-12f));
 		}
 
 		void BindTexture(TextureClass& tex) {
 			pTex = &tex;
 			tex_width = pTex->GetWidth();
 			tex_height = pTex->GetHeight();
+			sampler.Bind(tex);
 		}
 
 	private:
+		ColorIntegers ShadePixel(VSOutput& in, float lod) {
+
+			// the fast arithmetic only exists batched, shade a quad of copies
+			if (precision == ShadingPrecision::Fast) {
+				const VSOutput quad[4] = { in, in, in, in };
+				unsigned int colors[4];
+				ShadeQuad(quad, 1u, lod, colors);
+				return ColorIntegers(colors[0]);
+			}
+
+			const DirectX::XMFLOAT4 color = sampler.Sample(in.t.x, in.t.y, lod);
+			auto material_color_t = DirectX::XMFLOAT3(color.x, color.y, color.z);
+
+			return Shade(in, material_color_t);
+		}
+
+		void ShadeQuad(const VSOutput (&in)[4], unsigned int laneMask, float lod, unsigned int (&colors)[4]) {
+
+			// material color from the texture, a gather
+			float texel[3][4] = {};
+			for (int i = 0; i < 4; i++) {
+				if (laneMask & (1u << i)) {
+					const DirectX::XMFLOAT4 color = sampler.Sample(in[i].t.x, in[i].t.y, lod);
+					texel[0][i] = color.x;
+					texel[1][i] = color.y;
+					texel[2][i] = color.z;
+				}
+			}
+
+			// transpose the interpolants
+			__m128 n[3];
+			__m128 worldPos[3];
+			n[0] = _mm_set_ps(in[3].n.x, in[2].n.x, in[1].n.x, in[0].n.x);
+			n[1] = _mm_set_ps(in[3].n.y, in[2].n.y, in[1].n.y, in[0].n.y);
+			n[2] = _mm_set_ps(in[3].n.z, in[2].n.z, in[1].n.z, in[0].n.z);
+			worldPos[0] = _mm_set_ps(in[3].worldPos.x, in[2].worldPos.x, in[1].worldPos.x, in[0].worldPos.x);
+			worldPos[1] = _mm_set_ps(in[3].worldPos.y, in[2].worldPos.y, in[1].worldPos.y, in[0].worldPos.y);
+			worldPos[2] = _mm_set_ps(in[3].worldPos.z, in[2].worldPos.z, in[1].worldPos.z, in[0].worldPos.z);
+
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const bool fast = precision == ShadingPrecision::Fast;
+
+			// re-normalize interpolated surface normal
+			Normalize(n, fast);
+
+			// vertex to light data
+			__m128 v_to_l[3] = {
+				_mm_sub_ps(_mm_set1_ps(light_pos.x), worldPos[0]),
+				_mm_sub_ps(_mm_set1_ps(light_pos.y), worldPos[1]),
+				_mm_sub_ps(_mm_set1_ps(light_pos.z), worldPos[2])
+			};
+			__m128 dir[3] = { v_to_l[0], v_to_l[1], v_to_l[2] };
+			__m128 dist;
+			if (fast) {
+				// length and direction from the same reciprocal square root
+				const __m128 lengthSq = Dot(v_to_l, v_to_l);
+				const __m128 invLength = ReciprocalSqrt(lengthSq, true);
+				dist = _mm_and_ps(_mm_cmpgt_ps(lengthSq, zero), _mm_mul_ps(lengthSq, invLength));
+				Normalize(dir, invLength, lengthSq);
+			}
+			else {
+				dist = _mm_sqrt_ps(Dot(v_to_l, v_to_l));
+				Normalize(dir, false);
+			}
+
+			// calculate attenuation
+			const __m128 attenuation = Reciprocal(_mm_add_ps(_mm_add_ps(
+				_mm_set1_ps(PointDiffuseParams::constant_attenuation),
+				_mm_mul_ps(_mm_set1_ps(PointDiffuseParams::linear_attenuation), dist)),
+				_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(PointDiffuseParams::quadradic_attenuation), dist), dist)), fast);
+
+			// intensity based on angle of incidence and attenuation
+			const __m128 diffuse = _mm_mul_ps(attenuation, _mm_max_ps(zero, Dot(n, dir)));
+
+			// reflected light vector
+			const __m128 twoDot = _mm_mul_ps(_mm_set1_ps(2.0f), Dot(v_to_l, n));
+			__m128 r[3] = {
+				_mm_sub_ps(v_to_l[0], _mm_mul_ps(n[0], twoDot)),
+				_mm_sub_ps(v_to_l[1], _mm_mul_ps(n[1], twoDot)),
+				_mm_sub_ps(v_to_l[2], _mm_mul_ps(n[2], twoDot))
+			};
+			Normalize(r, fast);
+			Normalize(worldPos, fast);
+
+			// specular intensity based on angle between viewing vector and reflection vector, narrowed with the power
+			const __m128 cosine = _mm_max_ps(zero, _mm_sub_ps(zero, Dot(r, worldPos)));
+			const __m128 power = fast ? Pow(cosine, int(SpecularParams::specular_power)) : Pow(cosine, SpecularParams::specular_power);
+			const __m128 specular = _mm_mul_ps(_mm_set1_ps(SpecularParams::specular_intensity), power);
+
+			// add diffuse+ambient, filter by material color, saturate and scale
+			const float diffuseLight[3] = { light_diffuse.x, light_diffuse.y, light_diffuse.z };
+			const float ambientLight[3] = { light_ambient.x, light_ambient.y, light_ambient.z };
+			__m128i channels[3];
+			for (int c = 0; c < 3; c++) {
+				const __m128 light = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(diffuseLight[c]), diffuse), _mm_set1_ps(ambientLight[c])),
+					_mm_mul_ps(_mm_set1_ps(diffuseLight[c]), specular));
+				const __m128 value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(texel[c]), light), zero), one);
+				channels[c] = _mm_cvttps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f)));
+			}
+
+			// pack to 0x00RRGGBB
+			const __m128i packed = _mm_or_si128(_mm_or_si128(
+				_mm_slli_epi32(channels[0], 16),
+				_mm_slli_epi32(channels[1], 8)),
+				channels[2]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(colors), packed);
+		}
+
+		// four 3d vectors in structure of arrays form
+		static __m128 Dot(const __m128 (&a)[3], const __m128 (&b)[3]) {
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+		}
+
+		// 1 / x, estimate refined with one newton-raphson step when fast: r' = r * (2 - x * r)
+		static __m128 Reciprocal(__m128 x, bool fast) {
+			if (!fast) {
+				return _mm_div_ps(_mm_set1_ps(1.0f), x);
+			}
+			const __m128 r = _mm_rcp_ps(x);
+			return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(x, r)));
+		}
+
+		// 1 / sqrt(x), estimate refined with one newton-raphson step when fast: r' = r * (1.5 - 0.5 * x * r * r)
+		static __m128 ReciprocalSqrt(__m128 x, bool fast) {
+			if (!fast) {
+				return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x));
+			}
+			const __m128 r = _mm_rsqrt_ps(x);
+			return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), _mm_mul_ps(r, r))));
+		}
+
+		// scales by invLength, vectors whose magnitude (length or squared length) is zero are left alone
+		static void Normalize(__m128 (&v)[3], __m128 invLength, __m128 magnitude) {
+			const __m128 nonZero = _mm_cmpgt_ps(magnitude, _mm_setzero_ps());
+			const __m128 scale = _mm_or_ps(_mm_and_ps(nonZero, invLength), _mm_andnot_ps(nonZero, _mm_set1_ps(1.0f)));
+			for (int c = 0; c < 3; c++) {
+				v[c] = _mm_mul_ps(v[c], scale);
+			}
+		}
+
+		static void Normalize(__m128 (&v)[3], bool fast) {
+			if (fast) {
+				const __m128 lengthSq = Dot(v, v);
+				Normalize(v, ReciprocalSqrt(lengthSq, true), lengthSq);
+			}
+			else {
+				// divided by the length and zero for zero length, the same rounding as XMVector3Normalize
+				const __m128 length = _mm_sqrt_ps(Dot(v, v));
+				const __m128 nonZero = _mm_cmpneq_ps(length, _mm_setzero_ps());
+				for (int c = 0; c < 3; c++) {
+					v[c] = _mm_and_ps(_mm_div_ps(v[c], length), nonZero);
+				}
+			}
+		}
+
+		// x^power with std::pow per lane, as the single pixel shader computes it
+		static __m128 Pow(__m128 x, float power) {
+			float lanes[4];
+			_mm_storeu_ps(lanes, x);
+			for (int i = 0; i < 4; i++) {
+				lanes[i] = std::pow(lanes[i], power);
+			}
+			return _mm_loadu_ps(lanes);
+		}
+
+		// x^power by repeated squaring, rounds differently than std::pow (see ShadingPrecision)
+		static __m128 Pow(__m128 x, int power) {
+			__m128 result = _mm_set1_ps(1.0f);
+			for (; power > 0; power >>= 1) {
+				if (power & 1) {
+					result = _mm_mul_ps(result, x);
+				}
+				x = _mm_mul_ps(x, x);
+			}
+			return result;
+		}
+
 		DirectX::XMFLOAT3 light_pos			= { 0.0f,0.0f,0.5f };
 		DirectX::XMFLOAT3 light_diffuse		= { 1.0f,1.0f,1.0f };
 		DirectX::XMFLOAT3 light_ambient		= { 0.1f,0.1f,0.1f };
 
 		DirectX::XMFLOAT3 material_color	= { 0.8f,0.85f,1.0f };
+		ShadingPrecision precision = ShadingPrecision::Exact;
 		TextureClass* pTex = nullptr;
+		TextureSampler sampler;
 		unsigned int tex_width;
 		unsigned int tex_height;
 	};
@@ -2,10 +2,16 @@
 
 #include "GraphicsClass.h"
 
-SpecularPhongPointScene::SpecularPhongPointScene(TextureClass& sysT, TextureClass& wallT) : Scene("phong point shader scene free mesh") {
+SpecularPhongPointScene::SpecularPhongPointScene(TextureClass& sysT, TextureClass& wallT, unsigned int rasterThreads, bool fastShading, DepthFormat depthFormat) : Scene("phong point shader scene free mesh") {
 
 	pZb = std::make_shared<ZBuffer>(sysT.GetWidth(), sysT.GetHeight());
 	pipeline = std::make_shared<SpecularPhongPointPipeline>(sysT);
+	pipeline->SetRasterMode(SpecularPhongPointPipeline::RasterMode::HalfSpace);
+	pipeline->SetThreadCount(rasterThreads);
+	// lets BeginFrame clear the render target tile by tile, only where something is drawn
+	pipeline->SetTargetLayout(SpecularPhongPointPipeline::TargetLayout::Tiled);
+	pipeline->SetDepthFormat(depthFormat);
+	pipeline->effect.ps.SetPrecision(fastShading ? SpecularPhongPointEffect::ShadingPrecision::Fast : SpecularPhongPointEffect::ShadingPrecision::Exact);
 
 	// Set the initial position of the camera.
 	m_Camera.SetPosition(0.0f, 0.0f, -1.0f);
@@ -30,7 +36,7 @@ void SpecularPhongPointScene::Update(float dt) {
 
 void SpecularPhongPointScene::Draw() {
 
-	pipeline->BeginFrame();
+	pipeline->BeginFrame(clearColor);
 
 	DirectX::XMMATRIX view = m_Camera.GetViewMatrix();
 	DirectX::XMVECTOR l_posXM = DirectX::XMLoadFloat4(&l_pos);
@@ -55,6 +61,20 @@ void SpecularPhongPointScene::Draw() {
 		pipeline->effect.ps.BindTexture(w.pTex);
 		pipeline->Draw(w.model);
 	}
+
+	pipeline->EndFrame();
+}
+
+void SpecularPhongPointScene::SetClearColor(ColorIntegers color) {
+	clearColor = color;
+}
+
+void SpecularPhongPointScene::SetDepthPrepass(bool enabled) {
+	pipeline->SetShadingMode(enabled ? SpecularPhongPointPipeline::ShadingMode::DepthPrepass : SpecularPhongPointPipeline::ShadingMode::Forward);
+}
+
+void SpecularPhongPointScene::SetSampleCount(unsigned int samples) {
+	pipeline->SetSampleCount(samples);
 }
 
 CameraClass& SpecularPhongPointScene::GetCamera() {
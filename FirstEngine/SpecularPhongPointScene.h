@@ -23,13 +23,22 @@ public:
 		DirectX::XMFLOAT4X4	world;
 	};
 
-	SpecularPhongPointScene(TextureClass& sysT, TextureClass& wallT);
+	SpecularPhongPointScene(TextureClass& sysT, TextureClass& wallT, unsigned int rasterThreads = 1, bool fastShading = true, DepthFormat depthFormat = DepthFormat::Float32);
 
 	virtual void Update(float dt) override;
 	virtual void Draw() override;
 
 	CameraClass& GetCamera();
 
+	// color the render target is cleared to at the start of every Draw
+	void SetClearColor(ColorIntegers color);
+
+	// shades only the pixels that end up visible, at the cost of rasterizing every triangle twice
+	void SetDepthPrepass(bool enabled);
+
+	// samples per pixel, 4 smooths triangle edges for a fraction of the cost of rendering at a higher resolution
+	void SetSampleCount(unsigned int samples);
+
 private:
 	float t = 0.0f;
 
@@ -52,6 +61,8 @@ private:
 	// camera stuff
 	CameraClass m_Camera;
 
+	ColorIntegers clearColor = ColorIntegers(0u);
+
 	// wall stuff
 	static constexpr float tScaleCeiling = 0.5f;
 	//static constexpr float tScaleWall = 0.65f;
@@ -6,7 +6,7 @@ TextureClass::TextureClass() {
 
 TextureClass::~TextureClass() {}
 
-bool TextureClass::Initialize(const std::string& filename) {
+bool TextureClass::Initialize(const std::string& filename, TexelLayout layout) {
 	HRESULT hResult;
 
 	// Load the targa image data into memory.
@@ -30,6 +30,11 @@ bool TextureClass::Initialize(const std::string& filename) {
 		return false;
 	}
 
+	// loaders write row after row
+	m_Layout = TexelLayout::Linear;
+	BuildMipChain();
+	SetLayout(layout);
+
 	return true;
 }
 
@@ -39,6 +44,8 @@ bool TextureClass::InitializeBlank(unsigned int width, unsigned int height, Colo
 	m_width = width;
 	m_height = height;
 	m_Data = std::vector<unsigned char>(width * height * 4);
+	m_Mips.clear();
+	m_Layout = TexelLayout::Linear;
 	Clear(color);
 
 	return true;
@@ -87,7 +94,9 @@ bool TextureClass::LoadToGPU(ID3D11Device* device, ID3D11DeviceContext* deviceCo
 	unsigned int rowPitch = (m_width * 4) * sizeof(unsigned char);
 
 	// Copy the image data into the texture.
-	deviceContext->UpdateSubresource(m_texture.Get(), 0, NULL, m_Data.data(), rowPitch, 0);
+	const std::vector<unsigned char> linearData = m_Layout == TexelLayout::Linear ? std::vector<unsigned char>() : GetLinearData();
+	const unsigned char* data = m_Layout == TexelLayout::Linear ? m_Data.data() : linearData.data();
+	deviceContext->UpdateSubresource(m_texture.Get(), 0, NULL, data, rowPitch, 0);
 
 	// Setup the shader resource view description.
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
@@ -121,7 +130,13 @@ void TextureClass::Update(ID3D11Device* device, ID3D11DeviceContext* deviceConte
 
 	// perform the copy line-by-line
 	unsigned char* v = reinterpret_cast<unsigned char*>(mappedSysBufferTexture.pData);
-	std::copy(m_Data.begin(), m_Data.end(), v);
+	if (m_Layout == TexelLayout::Linear) {
+		std::copy(m_Data.begin(), m_Data.end(), v);
+	}
+	else {
+		const std::vector<unsigned char> linearData = GetLinearData();
+		std::copy(linearData.begin(), linearData.end(), v);
+	}
 
 	// release the adapter memory
 	deviceContext->Unmap(m_texture.Get(), 0u);
@@ -151,7 +166,7 @@ bool TextureClass::CopyNoLoad(const TextureClass& src) {
 void TextureClass::PutPixel(unsigned int x, unsigned int y, ColorIntegers c) {
 
 	unsigned int* v = reinterpret_cast<unsigned int*>(m_Data.data());
-	v[y * m_width + x] = c.dword;
+	v[GetTexelIndex(0, x, y)] = c.dword;
 }
 
 void TextureClass::PutPixelAlphaBlend(unsigned int x, unsigned int y, ColorIntegers c) {
@@ -170,7 +185,7 @@ void TextureClass::PutPixelAlphaBlend(unsigned int x, unsigned int y, ColorInteg
 
 ColorIntegers TextureClass::GetPixel(unsigned int x, unsigned int y) const {
 	unsigned int* v = const_cast<unsigned int*>(reinterpret_cast<const unsigned int*>(m_Data.data()));
-	return v[y * m_width + x];
+	return v[GetTexelIndex(0, x, y)];
 }
 
 void TextureClass::DrawLine(float x1, float y1, float x2, float y2, ColorIntegers c) {
@@ -217,6 +232,142 @@ void TextureClass::DrawLine(float x1, float y1, float x2, float y2, ColorInteger
 	}
 }
 
+void TextureClass::BuildMipChain() {
+	m_Mips.clear();
+
+	for (unsigned int level = 1; GetMipWidth(level - 1) > 1u || GetMipHeight(level - 1) > 1u; level++) {
+		const unsigned int* src = GetMipData(level - 1);
+		const unsigned int srcWidth = GetMipWidth(level - 1);
+		const unsigned int srcHeight = GetMipHeight(level - 1);
+		const unsigned int width = GetMipWidth(level);
+		const unsigned int height = GetMipHeight(level);
+
+		std::vector<unsigned int> texels(GetStorageSize(width, height));
+		for (unsigned int y = 0; y < height; y++) {
+			// odd sizes repeat the last row / column
+			const unsigned int y0 = std::min(2u * y, srcHeight - 1u);
+			const unsigned int y1 = std::min(2u * y + 1u, srcHeight - 1u);
+			for (unsigned int x = 0; x < width; x++) {
+				const unsigned int x0 = std::min(2u * x, srcWidth - 1u);
+				const unsigned int x1 = std::min(2u * x + 1u, srcWidth - 1u);
+				const unsigned int box[4] = {
+					src[GetTexelIndex(level - 1, x0, y0)], src[GetTexelIndex(level - 1, x1, y0)],
+					src[GetTexelIndex(level - 1, x0, y1)], src[GetTexelIndex(level - 1, x1, y1)]
+				};
+
+				// box filter every byte channel, rounded
+				unsigned int texel = 0u;
+				for (unsigned int shift = 0u; shift < 32u; shift += 8u) {
+					unsigned int sum = 2u;
+					for (unsigned int i = 0; i < 4; i++) {
+						sum += (box[i] >> shift) & 0xFFu;
+					}
+					texel |= (sum / 4u) << shift;
+				}
+				texels[GetTexelIndex(level, x, y)] = texel;
+			}
+		}
+		m_Mips.push_back(std::move(texels));
+	}
+}
+
+unsigned int TextureClass::GetMipCount() const {
+	return (unsigned int)m_Mips.size() + 1u;
+}
+
+unsigned int TextureClass::GetMipWidth(unsigned int level) const {
+	return std::max(m_width >> level, 1u);
+}
+
+unsigned int TextureClass::GetMipHeight(unsigned int level) const {
+	return std::max(m_height >> level, 1u);
+}
+
+const unsigned int* TextureClass::GetMipData(unsigned int level) const {
+	if (level == 0) {
+		return reinterpret_cast<const unsigned int*>(m_Data.data());
+	}
+	return m_Mips[level - 1].data();
+}
+
+unsigned int* TextureClass::GetMipData(unsigned int level) {
+	return const_cast<unsigned int*>(static_cast<const TextureClass&>(*this).GetMipData(level));
+}
+
+unsigned int TextureClass::GetTexelIndex(unsigned int level, unsigned int x, unsigned int y) const {
+	if (m_Layout == TexelLayout::Tiled) {
+		const unsigned int tilesX = (GetMipWidth(level) + TexelTileSize - 1u) / TexelTileSize;
+		return TiledIndex(x, y, tilesX);
+	}
+	return y * GetMipWidth(level) + x;
+}
+
+unsigned int TextureClass::GetStorageSize(unsigned int width, unsigned int height) const {
+	if (m_Layout == TexelLayout::Tiled) {
+		const unsigned int tilesX = (width + TexelTileSize - 1u) / TexelTileSize;
+		const unsigned int tilesY = (height + TexelTileSize - 1u) / TexelTileSize;
+		return tilesX * tilesY * TexelTileSize * TexelTileSize;
+	}
+	return width * height;
+}
+
+void TextureClass::SetLayout(TexelLayout layout) {
+	if (layout == m_Layout) {
+		return;
+	}
+
+	// gather every level in the old layout, then scatter into the new one
+	const unsigned int levelCount = GetMipCount();
+	std::vector<std::vector<unsigned int>> linearLevels(levelCount);
+	for (unsigned int level = 0; level < levelCount; level++) {
+		const unsigned int* src = GetMipData(level);
+		const unsigned int width = GetMipWidth(level);
+		const unsigned int height = GetMipHeight(level);
+		linearLevels[level].resize(width * height);
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				linearLevels[level][y * width + x] = src[GetTexelIndex(level, x, y)];
+			}
+		}
+	}
+
+	m_Layout = layout;
+	for (unsigned int level = 0; level < levelCount; level++) {
+		const unsigned int width = GetMipWidth(level);
+		const unsigned int height = GetMipHeight(level);
+		std::vector<unsigned int> texels(GetStorageSize(width, height));
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				texels[GetTexelIndex(level, x, y)] = linearLevels[level][y * width + x];
+			}
+		}
+
+		if (level == 0) {
+			m_Data.resize(texels.size() * 4);
+			std::memcpy(m_Data.data(), texels.data(), m_Data.size());
+		}
+		else {
+			m_Mips[level - 1] = std::move(texels);
+		}
+	}
+}
+
+TextureClass::TexelLayout TextureClass::GetLayout() const {
+	return m_Layout;
+}
+
+std::vector<unsigned char> TextureClass::GetLinearData() const {
+	std::vector<unsigned char> data(m_width * m_height * 4);
+	unsigned int* dst = reinterpret_cast<unsigned int*>(data.data());
+	const unsigned int* src = GetMipData(0);
+	for (unsigned int y = 0; y < m_height; y++) {
+		for (unsigned int x = 0; x < m_width; x++) {
+			dst[y * m_width + x] = src[GetTexelIndex(0, x, y)];
+		}
+	}
+	return data;
+}
+
 ID3D11ShaderResourceView* TextureClass::GetTexture() {
 	return m_textureView.Get();
 }
@@ -24,12 +24,30 @@ private:
 	};
 
 public:
+	// storage order of the texels, of the image and all mip levels
+	//   Linear - row after row, what the gpu expects
+	//   Tiled  - TexelTileSize x TexelTileSize tiles (64 bytes, one cache line) stored row after row,
+	//            texels row after row inside a tile, so filtering and sampling along columns
+	//            or rotated directions touches a few lines instead of one line per texel
+	enum class TexelLayout {
+		Linear,
+		Tiled
+	};
+
+	static constexpr unsigned int TexelTileSize = 4;
+
+	// index of texel (x, y) in a Tiled level that is tilesX tiles wide
+	static unsigned int TiledIndex(unsigned int x, unsigned int y, unsigned int tilesX) {
+		return ((y / TexelTileSize) * tilesX + x / TexelTileSize) * (TexelTileSize * TexelTileSize) + (y % TexelTileSize) * TexelTileSize + x % TexelTileSize;
+	}
+
 	TextureClass();
 	TextureClass(const TextureClass&) = delete;
 	TextureClass& operator=(const TextureClass&) = delete;
 	~TextureClass();
 
-	bool Initialize(const std::string&);
+	// loaded images are converted to layout (and get their mip chain) right away
+	bool Initialize(const std::string&, TexelLayout layout = TexelLayout::Tiled);
 	bool InitializeBlank(unsigned int width, unsigned int height, ColorIntegers color);
 
 	bool LoadToGPU(ID3D11Device* device, ID3D11DeviceContext* deviceContext, D3D11_USAGE usage, UINT cpuAccess);
@@ -43,6 +61,26 @@ public:
 	ColorIntegers GetPixel(unsigned int x, unsigned int y) const;
 	void DrawLine(float x1, float y1, float x2, float y2, ColorIntegers c);
 
+	// cpu mip chain, built when an image is loaded (blank textures only have level 0)
+	// level 0 is the image itself, every further level halves the size down to 1x1
+	// must be rebuilt after writing pixels of a loaded texture
+	void BuildMipChain();
+	unsigned int GetMipCount() const;
+	unsigned int GetMipWidth(unsigned int level) const;
+	unsigned int GetMipHeight(unsigned int level) const;
+	// texels of a level in the texture's layout, one packed ColorIntegers per texel
+	const unsigned int* GetMipData(unsigned int level) const;
+	// writable texels, for render targets filled in bulk
+	unsigned int* GetMipData(unsigned int level);
+	// position of texel (x, y) of a level in GetMipData
+	unsigned int GetTexelIndex(unsigned int level, unsigned int x, unsigned int y) const;
+
+	// reorders the texels of the image and all mip levels
+	void SetLayout(TexelLayout layout);
+	TexelLayout GetLayout() const;
+	// the image row after row whatever the layout, for uploads
+	std::vector<unsigned char> GetLinearData() const;
+
 	ID3D11ShaderResourceView* GetTexture();
 
 	unsigned int GetWidth() const;
@@ -52,7 +90,13 @@ private:
 	bool LoadTga(const std::string&);
 	bool LoadBmp(const std::string&);
 
+	// texels a level of the given size takes in the current layout (tiled levels are padded to whole tiles)
+	unsigned int GetStorageSize(unsigned int width, unsigned int height) const;
+
 	std::vector<unsigned char>							m_Data;
+	// mip levels 1 and up
+	std::vector<std::vector<unsigned int>>				m_Mips;
+	TexelLayout											m_Layout = TexelLayout::Linear;
 	Microsoft::WRL::ComPtr<ID3D11Texture2D>				m_texture;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	m_textureView;
 
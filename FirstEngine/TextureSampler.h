@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <DirectXMath.h>
+
+#include "TextureClass.h"
+
+// filtered lookups into the cpu mip chain of a TextureClass, texture coordinates wrap
+// holds plain pointers into the texture, so pixel shaders owning one stay trivially copyable
+class TextureSampler {
+public:
+	// Nearest   - closest texel of the closest mip level
+	// Bilinear  - 2x2 texels of the closest mip level
+	// Trilinear - bilinear in the two mip levels around the lod, blended
+	enum class Filter {
+		Nearest,
+		Bilinear,
+		Trilinear
+	};
+
+	// enough for 32k textures
+	static constexpr unsigned int MaxMipLevels = 16;
+
+	void Bind(const TextureClass& texture) {
+		levelCount = std::min(texture.GetMipCount(), MaxMipLevels);
+		// halving a power of two size keeps it one, so level 0 decides for the whole chain
+		powerOfTwo = Log2(texture.GetWidth()) >= 0 && Log2(texture.GetHeight()) >= 0;
+		for (unsigned int level = 0; level < levelCount; level++) {
+			levels[level].texels = texture.GetMipData(level);
+			levels[level].width = int(texture.GetMipWidth(level));
+			levels[level].height = int(texture.GetMipHeight(level));
+			levels[level].widthBits = Log2(texture.GetMipWidth(level));
+			levels[level].heightBits = Log2(texture.GetMipHeight(level));
+			levels[level].tilesX = texture.GetLayout() == TextureClass::TexelLayout::Tiled ?
+				int((texture.GetMipWidth(level) + TextureClass::TexelTileSize - 1u) / TextureClass::TexelTileSize) : 0;
+		}
+	}
+
+	void SetFilter(Filter filter_in) {
+		filter = filter_in;
+	}
+
+	Filter GetFilter() const {
+		return filter;
+	}
+
+	// color at (u, v), 1 being the whole texture, as 0..1 floats in ColorIntegers channel order (x = R, y = G, z = B, w = A)
+	// lod is log2 of the pixel's texel footprint on level 0, below 0 the texture is magnified
+	DirectX::XMFLOAT4 Sample(float u, float v, float lod) const {
+		if (powerOfTwo) {
+			return SampleFixed(ToFixed(u), ToFixed(v), lod);
+		}
+
+		const float level = std::min(std::max(lod, 0.0f), float(levelCount - 1u));
+
+		switch (filter) {
+		case Filter::Nearest:
+			return Point(levels[(unsigned int)(level + 0.5f)], u, v);
+		case Filter::Bilinear:
+			return Bilinear(levels[(unsigned int)(level + 0.5f)], u, v);
+		default: {
+			const unsigned int level0 = (unsigned int)level;
+			const float blend = level - float(level0);
+			DirectX::XMFLOAT4 color = Bilinear(levels[level0], u, v);
+			if (blend > 0.0f) {
+				const DirectX::XMFLOAT4 color1 = Bilinear(levels[level0 + 1u], u, v);
+				color.x += (color1.x - color.x) * blend;
+				color.y += (color1.y - color.y) * blend;
+				color.z += (color1.z - color.z) * blend;
+				color.w += (color1.w - color.w) * blend;
+			}
+			return color;
+		}
+		}
+	}
+
+private:
+	// power of two textures are addressed in fixed point, (u, v) become 0.32 fractions of the texture
+	// so wrapping is the integer overflow, every level and tap derives its 16.16 texel coordinates
+	// from them with shifts and masks, no floor, divide or modulo per tap; positions and filter weights
+	// are quantized to 1/65536 of a texel, so a filtered color can land one 1/255 step away from the float path
+	DirectX::XMFLOAT4 SampleFixed(unsigned int u, unsigned int v, float lod) const {
+		const float level = std::min(std::max(lod, 0.0f), float(levelCount - 1u));
+
+		switch (filter) {
+		case Filter::Nearest:
+			return PointFixed(levels[(unsigned int)(level + 0.5f)], u, v);
+		case Filter::Bilinear:
+			return BilinearFixed(levels[(unsigned int)(level + 0.5f)], u, v);
+		default: {
+			const unsigned int level0 = (unsigned int)level;
+			const float blend = level - float(level0);
+			DirectX::XMFLOAT4 color = BilinearFixed(levels[level0], u, v);
+			if (blend > 0.0f) {
+				const DirectX::XMFLOAT4 color1 = BilinearFixed(levels[level0 + 1u], u, v);
+				color.x += (color1.x - color.x) * blend;
+				color.y += (color1.y - color.y) * blend;
+				color.z += (color1.z - color.z) * blend;
+				color.w += (color1.w - color.w) * blend;
+			}
+			return color;
+		}
+		}
+	}
+
+	static_assert(TextureClass::TexelTileSize == 4, "Fetch addresses tiles with shifts and masks");
+
+	struct Level {
+		const unsigned int*	texels;
+		int					width;
+		int					height;
+		// tiles per row of a Tiled level, 0 for Linear
+		int					tilesX;
+		// log2 of the size, -1 if it is not a power of two
+		int					widthBits;
+		int					heightBits;
+	};
+
+	// log2 of power of two sizes the fixed point path can address, -1 otherwise
+	static int Log2(unsigned int size) {
+		if (size == 0u || (size & (size - 1u)) != 0u || size > 65536u) {
+			return -1;
+		}
+		int bits = 0;
+		while ((1u << bits) != size) {
+			bits++;
+		}
+		return bits;
+	}
+
+	// texture coordinate as a wrapped 0.32 fraction
+	static unsigned int ToFixed(float u) {
+		return (unsigned int)(long long)(u * 4294967296.0f);
+	}
+
+	// 16.16 texel coordinate on a level 2^bits texels wide, the integer part is already wrapped
+	static unsigned int ToTexel(unsigned int u, int bits) {
+		return u >> (16 - bits);
+	}
+
+	static unsigned int Fetch(const Level& level, int x, int y) {
+		if (level.tilesX > 0) {
+			return level.texels[(((y >> 2) * level.tilesX + (x >> 2)) << 4) + ((y & 3) << 2) + (x & 3)];
+		}
+		return level.texels[y * level.width + x];
+	}
+
+	static int Wrap(int i, int size) {
+		i %= size;
+		return i < 0 ? i + size : i;
+	}
+
+	static DirectX::XMFLOAT4 Unpack(unsigned int texel) {
+		return DirectX::XMFLOAT4(
+			float((texel >> 16u) & 0xFFu),
+			float((texel >> 8u) & 0xFFu),
+			float(texel & 0xFFu),
+			float(texel >> 24u)
+		);
+	}
+
+	static DirectX::XMFLOAT4 Point(const Level& level, float u, float v) {
+		const int x = Wrap(int(std::floor(u * float(level.width))), level.width);
+		const int y = Wrap(int(std::floor(v * float(level.height))), level.height);
+		const DirectX::XMFLOAT4 c = Unpack(Fetch(level, x, y));
+		return DirectX::XMFLOAT4(c.x / 255.0f, c.y / 255.0f, c.z / 255.0f, c.w / 255.0f);
+	}
+
+	static DirectX::XMFLOAT4 PointFixed(const Level& level, unsigned int u, unsigned int v) {
+		const int x = int(ToTexel(u, level.widthBits) >> 16u);
+		const int y = int(ToTexel(v, level.heightBits) >> 16u);
+		const DirectX::XMFLOAT4 c = Unpack(Fetch(level, x, y));
+		return DirectX::XMFLOAT4(c.x / 255.0f, c.y / 255.0f, c.z / 255.0f, c.w / 255.0f);
+	}
+
+	static DirectX::XMFLOAT4 BilinearFixed(const Level& level, unsigned int u, unsigned int v) {
+		// texel centers sit at half integers, stepping below 0 wraps to the last texel through the mask
+		const unsigned int tx = ToTexel(u, level.widthBits) - 0x8000u;
+		const unsigned int ty = ToTexel(v, level.heightBits) - 0x8000u;
+		const unsigned int maskX = (unsigned int)(level.width - 1);
+		const unsigned int maskY = (unsigned int)(level.height - 1);
+
+		const int x0 = int((tx >> 16u) & maskX);
+		const int y0 = int((ty >> 16u) & maskY);
+		const int x1 = int(((unsigned int)x0 + 1u) & maskX);
+		const int y1 = int(((unsigned int)y0 + 1u) & maskY);
+		const float ax = float(tx & 0xFFFFu) * (1.0f / 65536.0f);
+		const float ay = float(ty & 0xFFFFu) * (1.0f / 65536.0f);
+
+		return Blend(level, x0, y0, x1, y1, ax, ay);
+	}
+
+	static DirectX::XMFLOAT4 Bilinear(const Level& level, float u, float v) {
+		// texel centers sit at half integers
+		const float fx = u * float(level.width) - 0.5f;
+		const float fy = v * float(level.height) - 0.5f;
+		const float x0f = std::floor(fx);
+		const float y0f = std::floor(fy);
+		const float ax = fx - x0f;
+		const float ay = fy - y0f;
+
+		const int x0 = Wrap(int(x0f), level.width);
+		const int y0 = Wrap(int(y0f), level.height);
+		const int x1 = x0 + 1 < level.width ? x0 + 1 : 0;
+		const int y1 = y0 + 1 < level.height ? y0 + 1 : 0;
+
+		return Blend(level, x0, y0, x1, y1, ax, ay);
+	}
+
+	// weighs the 2x2 texels (x0..x1, y0..y1) by the position (ax, ay) between them
+	static DirectX::XMFLOAT4 Blend(const Level& level, int x0, int y0, int x1, int y1, float ax, float ay) {
+		const DirectX::XMFLOAT4 c00 = Unpack(Fetch(level, x0, y0));
+		const DirectX::XMFLOAT4 c10 = Unpack(Fetch(level, x1, y0));
+		const DirectX::XMFLOAT4 c01 = Unpack(Fetch(level, x0, y1));
+		const DirectX::XMFLOAT4 c11 = Unpack(Fetch(level, x1, y1));
+
+		const float w00 = (1.0f - ax) * (1.0f - ay) / 255.0f;
+		const float w10 = ax * (1.0f - ay) / 255.0f;
+		const float w01 = (1.0f - ax) * ay / 255.0f;
+		const float w11 = ax * ay / 255.0f;
+		return DirectX::XMFLOAT4(
+			c00.x * w00 + c10.x * w10 + c01.x * w01 + c11.x * w11,
+			c00.y * w00 + c10.y * w10 + c01.y * w01 + c11.y * w11,
+			c00.z * w00 + c10.z * w10 + c01.z * w01 + c11.z * w11,
+			c00.w * w00 + c10.w * w10 + c01.w * w01 + c11.w * w11
+		);
+	}
+
+	Level			levels[MaxMipLevels];
+	unsigned int	levelCount = 0;
+	bool			powerOfTwo = false;
+	Filter			filter = Filter::Trilinear;
+};
@@ -0,0 +1,90 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) : mNextJob(0), mPendingJobs(0) {
+
+	for (unsigned int i = 1; i < threadCount; i++) {
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+	}
+	mWakeCondition.notify_all();
+
+	for (auto& worker : mWorkers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job) {
+	if (count == 0) {
+		return;
+	}
+
+	// nothing to share the work with
+	if (mWorkers.empty() || count == 1) {
+		for (size_t i = 0; i < count; i++) {
+			job(i);
+		}
+		return;
+	}
+
+	{
+		// a worker that woke up late for the previous batch may still be scanning the job counter
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDoneCondition.wait(lock, [this] { return mBusyWorkers == 0; });
+
+		mJob = &job;
+		mJobCount = count;
+		mNextJob = 0;
+		mPendingJobs = count;
+		mGeneration++;
+	}
+	mWakeCondition.notify_all();
+
+	// the calling thread works on the batch as well
+	RunJobs();
+
+	// wait for the jobs picked up by the workers
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDoneCondition.wait(lock, [this] { return mPendingJobs == 0 && mBusyWorkers == 0; });
+	mJob = nullptr;
+}
+
+unsigned int ThreadPool::GetThreadCount() const {
+	return (unsigned int)mWorkers.size() + 1u;
+}
+
+void ThreadPool::WorkerLoop() {
+	unsigned long long seenGeneration = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCondition.wait(lock, [this, seenGeneration] { return mShutdown || mGeneration != seenGeneration; });
+			if (mShutdown) {
+				return;
+			}
+			seenGeneration = mGeneration;
+			mBusyWorkers++;
+		}
+
+		RunJobs();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mBusyWorkers--;
+		}
+		mDoneCondition.notify_all();
+	}
+}
+
+void ThreadPool::RunJobs() {
+	for (size_t i = mNextJob++; i < mJobCount; i = mNextJob++) {
+		(*mJob)(i);
+		mPendingJobs--;
+	}
+}
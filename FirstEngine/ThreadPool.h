@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads that run indexed jobs together with the calling thread
+class ThreadPool {
+public:
+	// threadCount includes the calling thread, so threadCount - 1 workers are spawned
+	ThreadPool(unsigned int threadCount);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	// runs job(i) for every i in [0, count) on the workers and the calling thread
+	// returns once every job has finished
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+	unsigned int GetThreadCount() const;
+
+private:
+	void WorkerLoop();
+	void RunJobs();
+
+	std::vector<std::thread>				mWorkers;
+
+	std::mutex								mMutex;
+	std::condition_variable					mWakeCondition;
+	std::condition_variable					mDoneCondition;
+
+	const std::function<void(size_t)>*		mJob = nullptr;
+	size_t									mJobCount = 0;
+	std::atomic<size_t>						mNextJob;
+	std::atomic<size_t>						mPendingJobs;
+
+	unsigned long long						mGeneration = 0;
+	unsigned int							mBusyWorkers = 0;
+	bool									mShutdown = false;
+};
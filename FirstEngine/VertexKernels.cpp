@@ -0,0 +1,134 @@
+#include "VertexKernels.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// gcc and clang only emit avx2 instructions in functions that ask for them,
+// msvc accepts the intrinsics anywhere
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+static void TransformStreamScalar(const float* x, const float* y, const float* z, const float* w, size_t count,
+	const DirectX::XMFLOAT4X4& m, float* out, size_t stride, int components) {
+
+	for (size_t i = 0; i < count; i++) {
+		const float wi = w ? w[i] : 0.0f;
+		float* point = out + i * stride;
+		for (int c = 0; c < components; c++) {
+			point[c] = ((wi * m(3, c) + z[i] * m(2, c)) + y[i] * m(1, c)) + x[i] * m(0, c);
+		}
+	}
+}
+
+// stores the leading components of a transposed point
+static inline void StorePoint(float* point, __m128 value, int components) {
+	if (components == 4) {
+		_mm_storeu_ps(point, value);
+	}
+	else {
+		_mm_storel_pi(reinterpret_cast<__m64*>(point), value);
+		_mm_store_ss(point + 2, _mm_movehl_ps(value, value));
+	}
+}
+
+static void TransformStreamSSE2(const float* x, const float* y, const float* z, const float* w, size_t count,
+	const DirectX::XMFLOAT4X4& m, float* out, size_t stride, int components) {
+
+	// every matrix element broadcast once for the whole stream
+	__m128 rows[4][4];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			rows[r][c] = _mm_set1_ps(m(r, c));
+		}
+	}
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 xv = _mm_loadu_ps(x + i);
+		const __m128 yv = _mm_loadu_ps(y + i);
+		const __m128 zv = _mm_loadu_ps(z + i);
+		const __m128 wv = w ? _mm_loadu_ps(w + i) : _mm_setzero_ps();
+
+		// one component of 4 points per register
+		__m128 result[4];
+		for (int c = 0; c < 4; c++) {
+			__m128 acc = _mm_mul_ps(wv, rows[3][c]);
+			acc = _mm_add_ps(acc, _mm_mul_ps(zv, rows[2][c]));
+			acc = _mm_add_ps(acc, _mm_mul_ps(yv, rows[1][c]));
+			result[c] = _mm_add_ps(acc, _mm_mul_ps(xv, rows[0][c]));
+		}
+
+		// back to one point per register
+		_MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+		for (int lane = 0; lane < 4; lane++) {
+			StorePoint(out + (i + lane) * stride, result[lane], components);
+		}
+	}
+
+	// leftover points that do not fill a register
+	if (i < count) {
+		TransformStreamScalar(x + i, y + i, z + i, w ? w + i : nullptr, count - i, m, out + i * stride, stride, components);
+	}
+}
+
+TARGET_AVX2 static void TransformStreamAVX2(const float* x, const float* y, const float* z, const float* w, size_t count,
+	const DirectX::XMFLOAT4X4& m, float* out, size_t stride, int components) {
+
+	// every matrix element broadcast once for the whole stream
+	__m256 rows[4][4];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			rows[r][c] = _mm256_set1_ps(m(r, c));
+		}
+	}
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 xv = _mm256_loadu_ps(x + i);
+		const __m256 yv = _mm256_loadu_ps(y + i);
+		const __m256 zv = _mm256_loadu_ps(z + i);
+		const __m256 wv = w ? _mm256_loadu_ps(w + i) : _mm256_setzero_ps();
+
+		// one component of 8 points per register
+		__m256 result[4];
+		for (int c = 0; c < 4; c++) {
+			__m256 acc = _mm256_mul_ps(wv, rows[3][c]);
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(zv, rows[2][c]));
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(yv, rows[1][c]));
+			result[c] = _mm256_add_ps(acc, _mm256_mul_ps(xv, rows[0][c]));
+		}
+
+		// back to one point per register, separately for the lower and upper 4 points
+		__m128 low[4];
+		__m128 high[4];
+		for (int c = 0; c < 4; c++) {
+			low[c] = _mm256_castps256_ps128(result[c]);
+			high[c] = _mm256_extractf128_ps(result[c], 1);
+		}
+		_MM_TRANSPOSE4_PS(low[0], low[1], low[2], low[3]);
+		_MM_TRANSPOSE4_PS(high[0], high[1], high[2], high[3]);
+		for (int lane = 0; lane < 4; lane++) {
+			StorePoint(out + (i + lane) * stride, low[lane], components);
+			StorePoint(out + (i + lane + 4) * stride, high[lane], components);
+		}
+	}
+
+	// leftover points that do not fill a register
+	if (i < count) {
+		TransformStreamSSE2(x + i, y + i, z + i, w ? w + i : nullptr, count - i, m, out + i * stride, stride, components);
+	}
+}
+
+TransformStreamKernel SelectTransformStreamKernel(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::AVX2:
+		return TransformStreamAVX2;
+	case SimdLevel::SSE2:
+		return TransformStreamSSE2;
+	default:
+		return TransformStreamScalar;
+	}
+}
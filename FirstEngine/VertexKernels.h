@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+#include <DirectXMath.h>
+
+#include "CpuFeatures.h"
+
+// transforms count points given as component streams by m, as row vectors like XMVector4Transform
+//   x, y, z  - component streams of the points
+//   w        - w stream, or nullptr for directions (w = 0)
+//   out      - component 0 of the first transformed point, point i is written to out + i * stride
+//   components - number of leading components written (3 or 4)
+// the matrix stays in registers for the whole stream; every level sums ((w * m3 + z * m2) + y * m1) + x * m0,
+// the order XMVector4Transform accumulates in when it is built without fused multiply-add
+using TransformStreamKernel = void (*)(const float* x, const float* y, const float* z, const float* w, size_t count,
+	const DirectX::XMFLOAT4X4& m, float* out, size_t stride, int components);
+
+// kernel for the given level, levels without a vectorized kernel fall back to the next lower one
+TransformStreamKernel SelectTransformStreamKernel(SimdLevel level);
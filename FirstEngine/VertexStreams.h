@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+// structure of arrays copy of a vertex list, one stream per component
+// lets vertex shaders load 4 or 8 vertices worth of a component with a single load
+class VertexStreams {
+public:
+	void Assign(const std::vector<Vertex>& vertices) {
+		const size_t count = vertices.size();
+		for (std::vector<float>* stream : { &x, &y, &z, &w, &nx, &ny, &nz, &u, &v }) {
+			stream->resize(count);
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			const Vertex& vertex = vertices[i];
+			x[i] = vertex.pos.x;
+			y[i] = vertex.pos.y;
+			z[i] = vertex.pos.z;
+			w[i] = vertex.pos.w;
+			nx[i] = vertex.n.x;
+			ny[i] = vertex.n.y;
+			nz[i] = vertex.n.z;
+			u[i] = vertex.t.x;
+			v[i] = vertex.t.y;
+		}
+	}
+
+	size_t Size() const {
+		return x.size();
+	}
+
+public:
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> w;
+	std::vector<float> nx;
+	std::vector<float> ny;
+	std::vector<float> nz;
+	std::vector<float> u;
+	std::vector<float> v;
+};
@@ -1,43 +1,254 @@
 #pragma once
 
 #include <limits>
+#include <cstring>
+#include <algorithm>
+
+#include "DepthFormat.h"
 
 class ZBuffer {
 public:
-	ZBuffer(int width, int height) : width(width), height(height), pBuffer(new float[width * height]) {}
+	// side of the square pixel tiles the coarse (hierarchical) depth level is kept for
+	static constexpr int TileSize = 8;
+
+	// storage order of the depth values
+	//   Linear - row after row
+	//   Tiled  - StorageTileSize x StorageTileSize tiles stored one after the other, rows inside a tile,
+	//            so everything a triangle touches in a tile stays in a few kilobytes of cache
+	enum class Layout {
+		Linear,
+		Tiled
+	};
+
+	static constexpr int StorageTileSize = 64;
+	static_assert(StorageTileSize % TileSize == 0, "coarse tiles must not straddle storage tiles");
+
+	// depths kept per pixel for multisampling, every sample has a plane laid out like a single sampled buffer
+	static constexpr int MaxSamples = 4;
+
+	ZBuffer(int width, int height, Layout layout = Layout::Linear, DepthFormat format = DepthFormat::Float32) :
+		width(width),
+		height(height),
+		tilesX((width + TileSize - 1) / TileSize),
+		tilesY((height + TileSize - 1) / TileSize),
+		storageTilesX((width + StorageTileSize - 1) / StorageTileSize),
+		layout(layout),
+		format(format),
+		pBuffer(new unsigned char[GetStorageSize(layout) * GetDepthFormatSize(format)]),
+		pTileMax(new float[tilesX * tilesY]),
+		pTileDirty(new bool[tilesX * tilesY]),
+		pTileCleared(new bool[tilesX * tilesY]()) {}
 	ZBuffer(const ZBuffer&) = delete;
 	~ZBuffer() {
 		delete[] pBuffer;
 		pBuffer = nullptr;
+		delete[] pTileMax;
+		pTileMax = nullptr;
+		delete[] pTileDirty;
+		pTileDirty = nullptr;
+		delete[] pTileCleared;
+		pTileCleared = nullptr;
 	}
 
 	ZBuffer& operator=(const ZBuffer&) = delete;
 
+	// fast clear, only the coarse tiles are reset and flagged,
+	// the depths of a tile are filled in when it is first accessed
 	void Clear() {
-		const int nDepths = width * height;
-		for (int i = 0; i < nDepths; i++) {
-			pBuffer[i] = std::numeric_limits<float>::infinity();
+		const int nTiles = tilesX * tilesY;
+		for (int i = 0; i < nTiles; i++) {
+			pTileMax[i] = std::numeric_limits<float>::infinity();
+			pTileDirty[i] = false;
+			pTileCleared[i] = true;
 		}
 	}
 
-	float& At(int x, int y) {
-		return pBuffer[y * width + x];
+	// count <= GetContiguousPixels(x) stored depths of a sample from (x, y) on, one after the other in the buffer's format
+	void* GetSpan(int x, int y, int count, int sample = 0) {
+		const int ty = y / TileSize;
+		for (int tx = x / TileSize, txEnd = (x + count - 1) / TileSize; tx <= txEnd; tx++) {
+			if (pTileCleared[ty * tilesX + tx]) {
+				FillTile(ty * tilesX + tx);
+			}
+		}
+		return pBuffer + (sample * GetStorageSize(layout) + Index(x, y, layout)) * GetDepthFormatSize(format);
 	}
 
-	const float& At(int x, int y) const {
-		return const_cast<ZBuffer*>(this)->At(x, y);
+	// stored depth of sample 0 at (x, y) as z (1 for the clear value of unorm formats)
+	float GetDepth(int x, int y) {
+		GetSpan(x, y, 1);
+		return Load(Index(x, y, layout));
 	}
 
+	// depth test and write of sample 0
 	bool TestAndSet(int x, int y, float depth) {
 
-		float& depthInBuffer = At(x, y);
-		if (depth < depthInBuffer) {
-			depthInBuffer = depth;
+		GetSpan(x, y, 1);
+		const int index = Index(x, y, layout);
+		if (format == DepthFormat::Float32 ? depth < Load(index) : EncodeDepthUnorm(depth, format) < LoadUnorm(index)) {
+			Store(index, depth);
+			MarkTileDirty(x / TileSize, y / TileSize);
 			return true;
 		}
 		return false;
 	}
 
+	// === coarse depth level ===
+	//   every tile keeps the farthest depth stored in its pixels
+	//   depth writes only ever bring pixels closer, so a stale tile max is still a
+	//   conservative bound; writers mark tiles dirty and the max is refreshed on the next query
+
+	// must be called after writing depth values through GetSpan
+	void MarkTileDirty(int tx, int ty) {
+		pTileDirty[ty * tilesX + tx] = true;
+	}
+
+	// farthest depth stored in the tile (by any sample), unorm depths decoded to z
+	// (z at or beyond the decoded value rounds to at least the stored integer, so the bound stays conservative)
+	float GetTileMax(int tx, int ty) {
+		const int tile = ty * tilesX + tx;
+		if (pTileDirty[tile]) {
+			const int xStart = tx * TileSize;
+			const int yStart = ty * TileSize;
+			const int xEnd = std::min(xStart + TileSize, width);
+			const int yEnd = std::min(yStart + TileSize, height);
+			const int planeSize = GetStorageSize(layout);
+
+			float maxDepth = -std::numeric_limits<float>::infinity();
+			if (format == DepthFormat::Float32) {
+				for (int sample = 0; sample < samples; sample++) {
+					for (int y = yStart; y < yEnd; y++) {
+						const int row = sample * planeSize + Index(xStart, y, layout);
+						for (int x = 0; x < xEnd - xStart; x++) {
+							maxDepth = std::max(maxDepth, Load(row + x));
+						}
+					}
+				}
+			}
+			else {
+				// compare the integers, decode once
+				unsigned int maxUnorm = 0u;
+				for (int sample = 0; sample < samples; sample++) {
+					for (int y = yStart; y < yEnd; y++) {
+						const int row = sample * planeSize + Index(xStart, y, layout);
+						for (int x = 0; x < xEnd - xStart; x++) {
+							maxUnorm = std::max(maxUnorm, LoadUnorm(row + x));
+						}
+					}
+				}
+				maxDepth = DecodeDepthUnorm(maxUnorm, format);
+			}
+
+			pTileMax[tile] = maxDepth;
+			pTileDirty[tile] = false;
+		}
+		return pTileMax[tile];
+	}
+
+	// true if nothing at depth minDepth or farther can pass the depth test
+	// anywhere in the pixel rect [xStart, xEnd) x [yStart, yEnd)
+	bool IsOccluded(int xStart, int yStart, int xEnd, int yEnd, float minDepth) {
+		for (int ty = yStart / TileSize, tyEnd = (yEnd - 1) / TileSize; ty <= tyEnd; ty++) {
+			for (int tx = xStart / TileSize, txEnd = (xEnd - 1) / TileSize; tx <= txEnd; tx++) {
+				if (minDepth < GetTileMax(tx, ty)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// pixels of row y stored contiguously from x on
+	int GetContiguousPixels(int x) const {
+		if (layout == Layout::Tiled) {
+			return std::min(StorageTileSize - x % StorageTileSize, width - x);
+		}
+		return width - x;
+	}
+
+	// reorders the stored depths
+	void SetLayout(Layout layout_in) {
+		if (layout_in == layout) {
+			return;
+		}
+
+		const int size = GetDepthFormatSize(format);
+		const int planeSize = GetStorageSize(layout);
+		const int planeSize_in = GetStorageSize(layout_in);
+		unsigned char* pReordered = new unsigned char[planeSize_in * samples * size];
+		for (int sample = 0; sample < samples; sample++) {
+			for (int y = 0; y < height; y++) {
+				for (int x = 0; x < width; x++) {
+					std::memcpy(pReordered + (sample * planeSize_in + Index(x, y, layout_in)) * size, pBuffer + (sample * planeSize + Index(x, y, layout)) * size, size);
+				}
+			}
+		}
+
+		delete[] pBuffer;
+		pBuffer = pReordered;
+		layout = layout_in;
+	}
+
+	Layout GetLayout() const {
+		return layout;
+	}
+
+	// converts the stored depths, going to a smaller format rounds them
+	void SetFormat(DepthFormat format_in) {
+		if (format_in == format) {
+			return;
+		}
+
+		const int nDepths = GetStorageSize(layout) * samples;
+		float* pDepths = new float[nDepths];
+		for (int i = 0; i < nDepths; i++) {
+			pDepths[i] = Load(i);
+		}
+
+		delete[] pBuffer;
+		format = format_in;
+		pBuffer = new unsigned char[nDepths * GetDepthFormatSize(format)];
+		for (int i = 0; i < nDepths; i++) {
+			Store(i, pDepths[i]);
+		}
+		delete[] pDepths;
+
+		// decoded tile maxima change with the precision
+		for (int i = 0; i < tilesX * tilesY; i++) {
+			pTileDirty[i] = !pTileCleared[i];
+		}
+	}
+
+	DepthFormat GetFormat() const {
+		return format;
+	}
+
+	// 1 or MaxSamples, new samples start out with the depths of sample 0, going back to 1 keeps sample 0
+	void SetSampleCount(int samples_in) {
+		if (samples_in == samples) {
+			return;
+		}
+
+		const int planeBytes = GetStorageSize(layout) * GetDepthFormatSize(format);
+		unsigned char* pResized = new unsigned char[planeBytes * samples_in];
+		for (int sample = 0; sample < samples_in; sample++) {
+			std::memcpy(pResized + sample * planeBytes, pBuffer, planeBytes);
+		}
+
+		delete[] pBuffer;
+		pBuffer = pResized;
+		samples = samples_in;
+	}
+
+	int GetSampleCount() const {
+		return samples;
+	}
+
+	// distance between neighbouring stored depths of a unorm format, 0 for Float32
+	float GetDepthStep() const {
+		return format == DepthFormat::Float32 ? 0.0f : 1.0f / float(GetDepthUnormMax(format));
+	}
+
 	int GetWidth() const {
 		return width;
 	}
@@ -47,7 +258,87 @@ public:
 	}
 
 private:
-	int		width;
-	int		height;
-	float*	pBuffer = nullptr;
-};
\ No newline at end of file
+	// writes the clear value to the depths of a flagged coarse tile, in every sample
+	void FillTile(int tile) {
+		const int xStart = (tile % tilesX) * TileSize;
+		const int yStart = (tile / tilesX) * TileSize;
+		const int count = std::min(TileSize, width - xStart);
+		const int planeSize = GetStorageSize(layout);
+		for (int sample = 0; sample < samples; sample++) {
+			for (int y = yStart, yEnd = std::min(yStart + TileSize, height); y < yEnd; y++) {
+				const int row = sample * planeSize + Index(xStart, y, layout);
+				switch (format) {
+				case DepthFormat::Float32:
+					std::fill_n(reinterpret_cast<float*>(pBuffer) + row, count, std::numeric_limits<float>::infinity());
+					break;
+				case DepthFormat::Unorm24:
+					std::fill_n(reinterpret_cast<unsigned int*>(pBuffer) + row, count, GetDepthUnormMax(format));
+					break;
+				default:
+					std::fill_n(reinterpret_cast<unsigned short*>(pBuffer) + row, count, (unsigned short)GetDepthUnormMax(format));
+					break;
+				}
+			}
+		}
+		pTileCleared[tile] = false;
+	}
+
+	// stored integer of a unorm format
+	unsigned int LoadUnorm(int index) const {
+		if (format == DepthFormat::Unorm16) {
+			return reinterpret_cast<const unsigned short*>(pBuffer)[index];
+		}
+		return reinterpret_cast<const unsigned int*>(pBuffer)[index];
+	}
+
+	float Load(int index) const {
+		if (format == DepthFormat::Float32) {
+			return reinterpret_cast<const float*>(pBuffer)[index];
+		}
+		return DecodeDepthUnorm(LoadUnorm(index), format);
+	}
+
+	void Store(int index, float depth) {
+		switch (format) {
+		case DepthFormat::Float32:
+			reinterpret_cast<float*>(pBuffer)[index] = depth;
+			break;
+		case DepthFormat::Unorm24:
+			reinterpret_cast<unsigned int*>(pBuffer)[index] = EncodeDepthUnorm(depth, format);
+			break;
+		default:
+			reinterpret_cast<unsigned short*>(pBuffer)[index] = (unsigned short)EncodeDepthUnorm(depth, format);
+			break;
+		}
+	}
+
+	int Index(int x, int y, Layout in) const {
+		if (in == Layout::Tiled) {
+			const int tile = (y / StorageTileSize) * storageTilesX + x / StorageTileSize;
+			return tile * (StorageTileSize * StorageTileSize) + (y % StorageTileSize) * StorageTileSize + x % StorageTileSize;
+		}
+		return y * width + x;
+	}
+
+	// depths of one sample plane, tiled storage is padded to whole tiles
+	int GetStorageSize(Layout in) const {
+		if (in == Layout::Tiled) {
+			const int storageTilesY = (height + StorageTileSize - 1) / StorageTileSize;
+			return storageTilesX * storageTilesY * StorageTileSize * StorageTileSize;
+		}
+		return width * height;
+	}
+
+	int				width;
+	int				height;
+	int				tilesX;
+	int				tilesY;
+	int				storageTilesX;
+	Layout			layout;
+	DepthFormat		format;
+	int				samples = 1;
+	unsigned char*	pBuffer = nullptr;
+	float*			pTileMax = nullptr;
+	bool*			pTileDirty = nullptr;
+	bool*			pTileCleared = nullptr;
+};
@@ -0,0 +1,260 @@
+// self-checking console program for the depth formats, the depth span kernels and the coarse depth level
+// prints every failed check and a timing line per format and level, returns non-zero if anything failed
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "CpuFeatures.h"
+#include "DepthFormat.h"
+#include "SpanKernels.h"
+#include "ZBuffer.h"
+
+static int failures = 0;
+
+static void Check(bool passed, const char* what, DepthFormat format) {
+	if (!passed) {
+		failures++;
+		std::printf("FAILED: %s (format %d)\n", what, int(format));
+	}
+}
+
+static const DepthFormat formats[] = { DepthFormat::Float32, DepthFormat::Unorm24, DepthFormat::Unorm16 };
+static const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 };
+
+// === encode / decode ===
+//   every stored integer survives a decode and encode, encoding never goes down as z goes up,
+//   and z outside [0, 1] clamps to the ends
+
+static void TestEncodeDecode(DepthFormat format) {
+	const unsigned int max = GetDepthUnormMax(format);
+
+	bool roundTrip = true;
+	for (unsigned int depth = 0u; depth <= max; depth++) {
+		roundTrip &= EncodeDepthUnorm(DecodeDepthUnorm(depth, format), format) == depth;
+	}
+	Check(roundTrip, "decoded depths encode back to the same integer", format);
+
+	// every float in [0, 1] after its neighbour below, the bits of positive floats order like the floats
+	bool monotonic = true;
+	unsigned int previous = EncodeDepthUnorm(0.0f, format);
+	unsigned int bits;
+	const float one = 1.0f;
+	std::memcpy(&bits, &one, sizeof(bits));
+	for (unsigned int i = 1u; i <= bits; i++) {
+		float z;
+		std::memcpy(&z, &i, sizeof(z));
+		const unsigned int depth = EncodeDepthUnorm(z, format);
+		monotonic &= depth >= previous;
+		previous = depth;
+	}
+	Check(monotonic, "encoding is monotonic in z", format);
+
+	Check(EncodeDepthUnorm(0.0f, format) == 0u && EncodeDepthUnorm(-1.0f, format) == 0u, "z <= 0 encodes to 0", format);
+	Check(EncodeDepthUnorm(1.0f, format) == max && EncodeDepthUnorm(2.0f, format) == max, "z >= 1 encodes to the largest value", format);
+}
+
+// === span kernels ===
+//   random spans through every level the cpu supports must produce the same mask, stored depths and w as the scalar kernel
+
+static void TestKernelAgreement(DepthFormat format, DepthTest test) {
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// the kernel selection does not look at the cpu, levels above it would fault
+	const int supported = int(DetectSimdLevel());
+	DepthSpanKernel kernels[3];
+	for (int level = 0; level <= supported; level++) {
+		kernels[level] = SelectDepthSpanKernel(levels[level], format, test);
+	}
+
+	const int size = GetDepthFormatSize(format);
+	int mismatches = 0;
+	for (int i = 0; i < 100000; i++) {
+		const int count = 1 + int(rng() % MaxSpanWidth);
+		const float z = unit(rng) * 1.1f - 0.05f;
+		const float dz = (unit(rng) - 0.5f) * 0.01f;
+		const float iw = 0.1f + unit(rng) * 4.0f;
+		const float diw = (unit(rng) - 0.5f) * 0.01f;
+		const unsigned int coverage = (unsigned int)rng();
+
+		// random stored depths, for the equal test half of them exactly what the span interpolates to
+		unsigned char initial[MaxSpanWidth * 4];
+		for (int j = 0; j < MaxSpanWidth; j++) {
+			const bool equal = test == DepthTest::Equal && (rng() & 1u) != 0u;
+			const float lane = z + float(j) * dz;
+			if (format == DepthFormat::Float32) {
+				const float depth = equal ? lane : unit(rng);
+				std::memcpy(initial + j * size, &depth, size);
+			}
+			else if (format == DepthFormat::Unorm24) {
+				const unsigned int depth = equal ? EncodeDepthUnorm(lane, format) : (unsigned int)rng() & 0xFFFFFFu;
+				std::memcpy(initial + j * size, &depth, size);
+			}
+			else {
+				const unsigned short depth = (unsigned short)(equal ? EncodeDepthUnorm(lane, format) : (unsigned int)rng());
+				std::memcpy(initial + j * size, &depth, size);
+			}
+		}
+
+		unsigned char depth[3][MaxSpanWidth * 4];
+		float w[3][MaxSpanWidth] = {};
+		unsigned int mask[3];
+		for (int level = 0; level <= supported; level++) {
+			std::memcpy(depth[level], initial, sizeof(initial));
+			mask[level] = kernels[level](depth[level], count, z, dz, iw, diw, coverage, w[level]);
+		}
+		for (int level = 1; level <= supported; level++) {
+			bool same = mask[level] == mask[0] && std::memcmp(depth[level], depth[0], sizeof(initial)) == 0;
+			for (int j = 0; j < count; j++) {
+				same &= (mask[0] & (1u << j)) == 0u || w[level][j] == w[0][j];
+			}
+			mismatches += same ? 0 : 1;
+		}
+	}
+	Check(mismatches == 0, test == DepthTest::Less ? "less kernels agree on every supported level" : "equal kernels agree on every supported level", format);
+}
+
+// === coarse depth level ===
+//   whenever some pixel of a rect would pass the depth test with z, IsOccluded must not reject the rect
+
+static void TestCoarseBound(DepthFormat format, ZBuffer::Layout layout, int samples) {
+	const int width = 100;
+	const int height = 70;
+	ZBuffer zb(width, height, layout, format);
+	zb.SetSampleCount(samples);
+	zb.Clear();
+
+	const DepthSpanKernel kernel = SelectDepthSpanKernel(SimdLevel::Scalar, format);
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// stored depth of a sample, the integer for unorm formats
+	auto stored = [&](int x, int y, int sample) {
+		unsigned int depth = 0u;
+		std::memcpy(&depth, zb.GetSpan(x, y, 1, sample), GetDepthFormatSize(format));
+		return depth;
+	};
+	auto storedFloat = [&](int x, int y, int sample) {
+		return *static_cast<const float*>(zb.GetSpan(x, y, 1, sample));
+	};
+
+	// the depth test of the kernels
+	auto passes = [&](int x, int y, int sample, float z) {
+		if (format == DepthFormat::Float32) {
+			return z < storedFloat(x, y, sample);
+		}
+		return EncodeDepthUnorm(z, format) < stored(x, y, sample);
+	};
+
+	// depth test and write of up to MaxSpanWidth pixels from (x, y) on, flags the tiles like the pipeline does
+	auto drawSpan = [&](int x, int y, int sample, float z, float dz) {
+		const int count = std::min(MaxSpanWidth, zb.GetContiguousPixels(x));
+		float w[MaxSpanWidth];
+		kernel(zb.GetSpan(x, y, count, sample), count, z, dz, 1.0f, 0.0f, 0xFFu, w);
+		for (int tx = x / ZBuffer::TileSize; tx <= (x + count - 1) / ZBuffer::TileSize; tx++) {
+			zb.MarkTileDirty(tx, y / ZBuffer::TileSize);
+		}
+		return count;
+	};
+
+	bool conservative = true;
+	for (int round = 0; round < 200; round++) {
+		// after the first clear every pixel of every sample gets a depth, before that cleared pixels stay around
+		if (round % 50 == 0 && round > 0) {
+			zb.Clear();
+			for (int sample = 0; sample < samples; sample++) {
+				for (int y = 0; y < height; y++) {
+					for (int x = 0; x < width; x += drawSpan(x, y, sample, unit(rng), (unit(rng) - 0.5f) * 0.01f)) {}
+				}
+			}
+		}
+
+		// a few more spans of depth writes
+		for (int span = 0; span < 20; span++) {
+			drawSpan(int(rng() % (unsigned int)width), int(rng() % (unsigned int)height), int(rng() % (unsigned int)samples), unit(rng), (unit(rng) - 0.5f) * 0.01f);
+		}
+
+		// small random rects against depths at, just in front of and just behind a stored one
+		for (int query = 0; query < 100; query++) {
+			const int xStart = int(rng() % (unsigned int)width);
+			const int yStart = int(rng() % (unsigned int)height);
+			const int xEnd = std::min(xStart + 1 + int(rng() % (2u * ZBuffer::TileSize)), width);
+			const int yEnd = std::min(yStart + 1 + int(rng() % (2u * ZBuffer::TileSize)), height);
+
+			const int px = xStart + int(rng() % (unsigned int)(xEnd - xStart));
+			const int py = yStart + int(rng() % (unsigned int)(yEnd - yStart));
+			const int ps = int(rng() % (unsigned int)samples);
+			const float depth = format == DepthFormat::Float32 ? storedFloat(px, py, ps) : DecodeDepthUnorm(stored(px, py, ps), format);
+			const float z = std::min(depth, 1.0f) + (unit(rng) - 0.5f) * 4.0f * std::max(zb.GetDepthStep(), 1e-7f);
+
+			bool anyPasses = false;
+			for (int sample = 0; sample < samples; sample++) {
+				for (int y = yStart; y < yEnd; y++) {
+					for (int x = xStart; x < xEnd; x++) {
+						anyPasses |= passes(x, y, sample, z);
+					}
+				}
+			}
+			conservative &= !anyPasses || !zb.IsOccluded(xStart, yStart, xEnd, yEnd, z);
+		}
+	}
+	Check(conservative, layout == ZBuffer::Layout::Linear ? "coarse level never hides a passing pixel (linear)" : "coarse level never hides a passing pixel (tiled)", format);
+}
+
+// === timing ===
+//   full spans over a 1024 pixel row, every pass a little closer so every pixel is tested and written
+
+static void TimeKernels(DepthFormat format) {
+	const int width = 1024;
+	const int repeats = 4000;
+	const SimdLevel supported = DetectSimdLevel();
+
+	ZBuffer zb(width, 1, ZBuffer::Layout::Linear, format);
+	float w[MaxSpanWidth];
+	for (int level = 0; level <= int(supported); level++) {
+		const DepthSpanKernel kernel = SelectDepthSpanKernel(levels[level], format);
+		zb.Clear();
+		unsigned char* row = static_cast<unsigned char*>(zb.GetSpan(0, 0, width));
+
+		int passed = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++) {
+			const float z = 0.9f - float(repeat) * 1e-4f;
+			for (int x = 0; x < width; x += MaxSpanWidth) {
+				passed += kernel(row + x * GetDepthFormatSize(format), MaxSpanWidth, z, -1e-7f, 1.0f, 1e-4f, 0xFFu, w) == 0xFFu ? 1 : 0;
+			}
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::printf("format %d level %d: %.2f ns per pixel, %d of %d spans passed\n", int(format), level,
+			seconds * 1e9 / (double(width) * repeats), passed, repeats * width / MaxSpanWidth);
+	}
+}
+
+int main() {
+	if (DetectSimdLevel() != SimdLevel::AVX2) {
+		std::printf("note: the cpu has no AVX2, AVX2 kernel agreement and timing are skipped\n");
+	}
+
+	for (DepthFormat format : formats) {
+		if (format != DepthFormat::Float32) {
+			TestEncodeDecode(format);
+		}
+		TestKernelAgreement(format, DepthTest::Less);
+		TestKernelAgreement(format, DepthTest::Equal);
+		for (int samples = 1; samples <= ZBuffer::MaxSamples; samples += ZBuffer::MaxSamples - 1) {
+			TestCoarseBound(format, ZBuffer::Layout::Linear, samples);
+			TestCoarseBound(format, ZBuffer::Layout::Tiled, samples);
+		}
+	}
+
+	for (DepthFormat format : formats) {
+		TimeKernels(format);
+	}
+
+	std::printf(failures == 0 ? "all depth checks passed\n" : "%d depth checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}